@@ -0,0 +1,68 @@
+/**
+ * @file arena.cpp
+ * @brief per-thread bump arena for the scratch of the decoders
+ */
+
+#include <new>
+#include <algorithm>
+
+#include "arena.hpp"
+
+scratch_arena& scratch_arena::local()
+{
+    static thread_local scratch_arena arena;
+    return arena;
+}
+
+scratch_arena::~scratch_arena()
+{
+    for (size_t uint_indx = 0; uint_indx < vec_chunks.size(); uint_indx++)
+    {
+        topology_free(vec_chunks[uint_indx].ptr, vec_chunks[uint_indx].size);
+    }
+}
+
+// An allocation that does not fit in the chunk being filled moves to the next chunk
+// large enough (the skipped space is reclaimed by the next rewind), or to a new one.
+void* scratch_arena::allocate(size_t size)
+{
+    size_t uint_align = size < TOPOLOGY_ALIGNMENT ? 16 : TOPOLOGY_ALIGNMENT;
+    size_t uint_start = (uint_offset + uint_align - 1) & ~(uint_align - 1);
+
+    if (uint_chunk < vec_chunks.size() && uint_start + size <= vec_chunks[uint_chunk].size)
+    {
+        uint_offset = uint_start + size;
+        return vec_chunks[uint_chunk].ptr + uint_start;
+    }
+
+    size_t uint_next = uint_chunk < vec_chunks.size() ? uint_chunk + 1 : 0;
+    while (uint_next < vec_chunks.size() && vec_chunks[uint_next].size < size) uint_next++;
+
+    if (uint_next == vec_chunks.size())
+    {
+        chunk c;
+        c.size = std::max<size_t>(SCRATCH_CHUNK_SIZE, size);
+        c.ptr  = (char*)topology_alloc(c.size, topology_node());
+
+        if (c.ptr == nullptr) throw std::bad_alloc();
+
+        vec_chunks.push_back(c);
+    }
+
+    uint_chunk  = uint_next;
+    uint_offset = size;
+
+    return vec_chunks[uint_chunk].ptr;
+}
+
+size_t scratch_arena::capacity() const
+{
+    size_t uint_capacity = 0;
+
+    for (size_t uint_indx = 0; uint_indx < vec_chunks.size(); uint_indx++)
+    {
+        uint_capacity += vec_chunks[uint_indx].size;
+    }
+
+    return uint_capacity;
+}
@@ -0,0 +1,116 @@
+/**
+ * @file arena.hpp
+ * @brief per-thread bump arena for the scratch of the decoders
+ *
+ * The decoders take their containers (activities, active fanals and clusters)
+ * from an arena owned by the calling thread: an allocation bumps an offset in a
+ * chunk and a release does nothing. A scratch_scope rewinds the arena when it is
+ * destroyed, so that every query reuses the memory of the previous ones instead
+ * of going through the heap. The chunks come from topology_alloc, i.e. from huge
+ * pages when possible.
+ *
+ * A scratch container must not outlive the scope it has been created in.
+ */
+#ifndef __ARENA_HPP__
+#define __ARENA_HPP__
+
+#include <vector>
+#include <cstdlib>
+
+#include "topology.hpp"
+
+#define SCRATCH_CHUNK_SIZE  TOPOLOGY_HUGE_PAGE  // the size of an arena chunk
+
+class scratch_arena
+{
+
+  public:
+    //! a position in the arena.
+    struct position
+    {
+        size_t chunk;
+        size_t offset;
+    };
+
+    //! the arena of the calling thread.
+    static scratch_arena& local();
+
+    ~scratch_arena();
+
+    scratch_arena(const scratch_arena&) = delete;
+    scratch_arena& operator=(const scratch_arena&) = delete;
+
+    //! allocates memory aligned to a cache line (to 16 bytes for less than a cache line).
+    void* allocate(size_t size);
+
+    //! the current position.
+    position mark() const { return position{uint_chunk, uint_offset}; }
+
+    //! releases the memory allocated since the position 'pos'.
+    void rewind(const position& pos)
+    {
+        uint_chunk  = pos.chunk;
+        uint_offset = pos.offset;
+    }
+
+    //! the memory taken by the chunks in bytes.
+    size_t capacity() const;
+
+  private:
+    scratch_arena() : uint_chunk(0), uint_offset(0) {}
+
+    struct chunk
+    {
+        char*  ptr;
+        size_t size;
+    };
+
+    std::vector<chunk>  vec_chunks;
+    size_t              uint_chunk;  // the chunk being filled
+    size_t              uint_offset; // the first free byte of the chunk being filled
+};
+
+/**
+ * @brief rewinds the arena of the calling thread at the end of its lifetime.
+ */
+class scratch_scope
+{
+
+  public:
+    scratch_scope() : arena(scratch_arena::local()), pos(arena.mark()) {}
+    ~scratch_scope() { arena.rewind(pos); }
+
+    scratch_scope(const scratch_scope&) = delete;
+    scratch_scope& operator=(const scratch_scope&) = delete;
+
+  private:
+    scratch_arena&          arena;
+    scratch_arena::position pos;
+};
+
+/**
+ * @brief standard allocator on the arena of the calling thread.
+ */
+template <typename T> class scratch_allocator
+{
+
+  public:
+    typedef T value_type;
+
+    scratch_allocator() {}
+    template <typename U> scratch_allocator(const scratch_allocator<U>&) {}
+
+    T* allocate(size_t n) { return (T*)scratch_arena::local().allocate(n * sizeof(T)); }
+    void deallocate(T*, size_t) {}
+};
+
+template <typename T, typename U> bool operator==(const scratch_allocator<T>&, const scratch_allocator<U>&) { return true; }
+template <typename T, typename U> bool operator!=(const scratch_allocator<T>&, const scratch_allocator<U>&) { return false; }
+
+//! a vector of the decoder scratch.
+typedef std::vector<size_t, scratch_allocator<size_t>> scratch_vector;
+
+//! a matrix (vector of vectors) of the decoder scratch.
+typedef std::vector<scratch_vector, scratch_allocator<scratch_vector>> scratch_matrix;
+
+#endif
@@ -0,0 +1,186 @@
+/**
+ * @file block.cpp
+ * @brief compressed block of connections between two clusters
+ */
+
+#include <iterator>
+
+#include "block.hpp"
+
+size_t block::bytes() const
+{
+    size_t uint_bytes = vec_list.capacity() * sizeof(uint32_t) +
+                        vec_chunks.capacity() * sizeof(chunk) +
+                        vec_bitmap.capacity() * sizeof(uint64_t);
+
+    for (std::vector<chunk>::const_iterator itc = vec_chunks.begin(); itc != vec_chunks.end(); itc++)
+    {
+        uint_bytes += itc->array.capacity() * sizeof(uint16_t) + itc->bitmap.capacity() * sizeof(uint64_t);
+    }
+
+    return uint_bytes;
+}
+
+void block::reset()
+{
+    std::vector<uint32_t>().swap(vec_list);
+    std::vector<chunk>().swap(vec_chunks);
+    std::vector<uint64_t>().swap(vec_bitmap);
+
+    type        = container_empty;
+    cardinality = 0;
+}
+
+bool block::test(uint32_t key) const
+{
+    switch (type)
+    {
+    case container_list:
+        return std::binary_search(vec_list.begin(), vec_list.end(), key);
+    case container_roaring:
+    {
+        std::vector<chunk>::const_iterator itc = std::lower_bound(vec_chunks.begin(), vec_chunks.end(), key >> 16, chunk_less);
+        if (itc == vec_chunks.end() || itc->high != key >> 16) return false;
+
+        uint16_t low = key & 0xffff;
+        if (itc->bitmap.empty()) return std::binary_search(itc->array.begin(), itc->array.end(), low);
+        return (itc->bitmap[low >> 6] >> (low & 63)) & 1;
+    }
+    case container_bitmap:
+        return (vec_bitmap[key >> 6] >> (key & 63)) & 1;
+    default:
+        return false;
+    }
+}
+
+// The keys are merged into the current container, which is then promoted
+// to the next one if it exceeds its capacity or takes more memory than a bitmap.
+void block::insert(const std::vector<uint32_t>& vec_keys, uint64_t universe)
+{
+    if (vec_keys.empty()) return;
+
+    switch (type)
+    {
+    case container_empty:
+    case container_list:
+    {
+        std::vector<uint32_t> vec_merged;
+        vec_merged.reserve(vec_list.size() + vec_keys.size());
+        std::set_union(vec_list.begin(), vec_list.end(), vec_keys.begin(), vec_keys.end(), std::back_inserter(vec_merged));
+
+        cardinality = vec_merged.size();
+
+        if (vec_merged.size() <= BLOCK_LIST_MAX)
+        {
+            vec_list.swap(vec_merged);
+            type = container_list;
+        }
+        else
+        {
+            std::vector<uint32_t>().swap(vec_list);
+            to_roaring(vec_merged);
+        }
+        break;
+    }
+    case container_roaring:
+        insert_roaring(vec_keys);
+        break;
+    case container_bitmap:
+        for (std::vector<uint32_t>::const_iterator itk = vec_keys.begin(); itk != vec_keys.end(); itk++)
+        {
+            uint64_t& word = vec_bitmap[*itk >> 6];
+            uint64_t  bit  = 1ULL << (*itk & 63);
+
+            cardinality += (word & bit) == 0;
+            word |= bit;
+        }
+        break;
+    }
+
+    if (type != container_bitmap && bytes() >= (universe + 63) / 64 * sizeof(uint64_t)) to_bitmap(universe);
+}
+
+void block::to_roaring(const std::vector<uint32_t>& vec_keys)
+{
+    vec_chunks.clear();
+    type        = container_roaring;
+    cardinality = 0;
+    insert_roaring(vec_keys);
+}
+
+// The keys are grouped by their upper 16 bits and merged into the chunk of each group.
+void block::insert_roaring(const std::vector<uint32_t>& vec_keys)
+{
+    std::vector<uint32_t>::const_iterator itk = vec_keys.begin();
+
+    while (itk != vec_keys.end())
+    {
+        uint16_t high = *itk >> 16;
+        std::vector<uint32_t>::const_iterator itk_end = itk;
+        while (itk_end != vec_keys.end() && (*itk_end >> 16) == high) itk_end++;
+
+        std::vector<chunk>::iterator itc = std::lower_bound(vec_chunks.begin(), vec_chunks.end(), high, chunk_less);
+        if (itc == vec_chunks.end() || itc->high != high)
+        {
+            itc = vec_chunks.insert(itc, chunk());
+            itc->high = high;
+        }
+
+        if (itc->bitmap.empty())
+        {
+            std::vector<uint16_t> vec_merged;
+            vec_merged.reserve(itc->array.size() + (itk_end - itk));
+
+            std::vector<uint16_t>::const_iterator ita = itc->array.begin();
+            for (; itk != itk_end; itk++)
+            {
+                uint16_t low = *itk & 0xffff;
+                while (ita != itc->array.end() && *ita < low) vec_merged.push_back(*ita++);
+                if (ita != itc->array.end() && *ita == low) ita++;
+                vec_merged.push_back(low);
+            }
+            vec_merged.insert(vec_merged.end(), ita, std::vector<uint16_t>::const_iterator(itc->array.end()));
+
+            cardinality += vec_merged.size() - itc->array.size();
+
+            if (vec_merged.size() <= BLOCK_ARRAY_MAX)
+            {
+                itc->array.swap(vec_merged);
+            }
+            else
+            {
+                // a dense chunk becomes a bitmap of its lower 16 bits.
+                itc->bitmap.assign(BLOCK_CHUNK_WORDS, 0);
+                for (std::vector<uint16_t>::const_iterator itm = vec_merged.begin(); itm != vec_merged.end(); itm++)
+                    itc->bitmap[*itm >> 6] |= 1ULL << (*itm & 63);
+                std::vector<uint16_t>().swap(itc->array);
+            }
+        }
+        else
+        {
+            for (; itk != itk_end; itk++)
+            {
+                uint64_t& word = itc->bitmap[(*itk & 0xffff) >> 6];
+                uint64_t  bit  = 1ULL << (*itk & 63);
+
+                cardinality += (word & bit) == 0;
+                word |= bit;
+            }
+        }
+    }
+}
+
+void block::to_bitmap(uint64_t universe)
+{
+    std::vector<uint64_t> vec_words((universe + 63) / 64, 0);
+
+    for_each(0, universe, [&vec_words](uint32_t key) {
+        vec_words[key >> 6] |= 1ULL << (key & 63);
+    });
+
+    std::vector<uint32_t>().swap(vec_list);
+    std::vector<chunk>().swap(vec_chunks);
+    vec_bitmap.swap(vec_words);
+
+    type = container_bitmap;
+}
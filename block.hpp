@@ -0,0 +1,150 @@
+/**
+ * @file block.hpp
+ * @brief compressed block of connections between two clusters
+ *
+ * A block holds the connections from the fanals of a source cluster to the
+ * fanals of a target cluster as a set of keys (source fanal * nf + target fanal),
+ * so that the connections of a source fanal form a contiguous range of keys.
+ *
+ * The container of a block follows its fill:
+ * - a sorted list of keys while the block holds at most BLOCK_LIST_MAX keys,
+ * - roaring-style chunks beyond that, i.e. the keys are split by their upper 16 bits
+ *   and each chunk is either a sorted array of the lower 16 bits or a bitmap of 2^16 bits
+ *   once it holds more than BLOCK_ARRAY_MAX keys,
+ * - a dense bitmap of nf * nf bits once any of the above would take more memory.
+ */
+#ifndef __BLOCK_HPP__
+#define __BLOCK_HPP__
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#define BLOCK_LIST_MAX      4096    // the maximum number of keys of a sorted list
+#define BLOCK_ARRAY_MAX     4096    // the maximum number of keys of an array chunk
+#define BLOCK_CHUNK_WORDS   1024    // the number of 64 bit words of a bitmap chunk
+
+class block
+{
+
+  public:
+    enum container
+    {
+        container_empty,
+        container_list,
+        container_roaring,
+        container_bitmap,
+    };
+
+    block() : type(container_empty), cardinality(0) {}
+
+    //! the kind of container that holds the keys.
+    container kind() const { return type; }
+
+    //! the number of keys (connections).
+    size_t size() const { return cardinality; }
+
+    //! true if the block holds no connection.
+    bool empty() const { return cardinality == 0; }
+
+    //! the memory taken by the keys in bytes.
+    size_t bytes() const;
+
+    //! erases all the keys.
+    void reset();
+
+    //! true if the block holds the key.
+    bool test(uint32_t key) const;
+
+    /**
+     * @brief inserts keys into the block.
+     * @param vec_keys the keys sorted in increasing order without duplicates.
+     * @param universe the number of possible keys (nf * nf).
+     */
+    void insert(const std::vector<uint32_t>& vec_keys, uint64_t universe);
+
+    /**
+     * @brief calls 'fn(key - first)' for every key in [first, last) in increasing order.
+     */
+    template <typename F> void for_each(uint32_t first, uint32_t last, F fn) const
+    {
+        switch (type)
+        {
+        case container_list:
+        {
+            std::vector<uint32_t>::const_iterator itk = std::lower_bound(vec_list.begin(), vec_list.end(), first);
+            for (; itk != vec_list.end() && *itk < last; itk++) fn(*itk - first);
+            break;
+        }
+        case container_roaring:
+        {
+            for (std::vector<chunk>::const_iterator itc = std::lower_bound(vec_chunks.begin(), vec_chunks.end(), first >> 16, chunk_less);
+                 itc != vec_chunks.end() && ((uint32_t)itc->high << 16) < last; itc++)
+            {
+                uint32_t base  = (uint32_t)itc->high << 16;
+                uint32_t lower = first > base ? first - base : 0;
+                uint32_t upper = std::min<uint64_t>(last - base, 1 << 16);
+
+                if (itc->bitmap.empty())
+                {
+                    std::vector<uint16_t>::const_iterator itk = std::lower_bound(itc->array.begin(), itc->array.end(), lower);
+                    for (; itk != itc->array.end() && *itk < upper; itk++) fn(base + *itk - first);
+                }
+                else
+                {
+                    for_each_bit(itc->bitmap.data(), lower, upper, base - first, fn);
+                }
+            }
+            break;
+        }
+        case container_bitmap:
+            for_each_bit(vec_bitmap.data(), first, last, 0 - first, fn);
+            break;
+        default:
+            break;
+        }
+    }
+
+  private:
+    struct chunk
+    {
+        uint16_t                high;   // the upper 16 bits of the keys
+        std::vector<uint16_t>   array;  // the sorted lower 16 bits (array chunk)
+        std::vector<uint64_t>   bitmap; // the bitmap of the lower 16 bits (bitmap chunk)
+    };
+
+    static bool chunk_less(const chunk& c, uint32_t high) { return c.high < high; }
+
+    // calls 'fn(bit + offset)' for every set bit in [first, last) of a bitmap.
+    template <typename F> static void for_each_bit(const uint64_t* ptr_words, uint32_t first, uint32_t last, uint32_t offset, F fn)
+    {
+        if (first >= last) return;
+
+        for (uint32_t word = first >> 6; word <= (last - 1) >> 6; word++)
+        {
+            uint64_t bits = ptr_words[word];
+
+            if (word == first >> 6)       bits &= ~0ULL << (first & 63);
+            if (word == (last - 1) >> 6 && (last & 63)) bits &= ~0ULL >> (64 - (last & 63));
+
+            while (bits)
+            {
+                fn((word << 6) + __builtin_ctzll(bits) + offset);
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    void to_roaring(const std::vector<uint32_t>& vec_keys);
+    void to_bitmap(uint64_t universe);
+    void insert_roaring(const std::vector<uint32_t>& vec_keys);
+
+    container               type;
+    size_t                  cardinality;
+    std::vector<uint32_t>   vec_list;   // sorted list container
+    std::vector<chunk>      vec_chunks; // roaring container (sorted by the upper bits)
+    std::vector<uint64_t>   vec_bitmap; // dense bitmap container
+};
+
+#endif
@@ -0,0 +1,130 @@
+/**
+ * @file capi.cpp
+ * @brief C interface of the Sparse Associative Memory (libsam.so)
+ */
+
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include "sam.h"
+#include "sam.hpp"
+
+// the description of the last error of the thread.
+static thread_local std::string str_error;
+
+// runs 'fn' and turns its exceptions into error codes.
+template <typename function_t> static int guarded(function_t fn)
+{
+    try
+    {
+        fn();
+        return SAM_OK;
+    }
+    catch (const std::invalid_argument& e)
+    {
+        str_error = e.what();
+        return SAM_ERROR_ARGUMENT;
+    }
+    catch (const std::bad_alloc& e)
+    {
+        str_error = "out of memory";
+        return SAM_ERROR_MEMORY;
+    }
+    catch (const std::exception& e)
+    {
+        str_error = e.what();
+        return SAM_ERROR_FAILURE;
+    }
+    catch (...)
+    {
+        str_error = "unknown error";
+        return SAM_ERROR_FAILURE;
+    }
+}
+
+static sam* memory(sam_network* network) { return reinterpret_cast<sam*>(network); }
+static const sam* memory(const sam_network* network) { return reinterpret_cast<const sam*>(network); }
+
+sam_network* sam_create(size_t nc, size_t nf, int storage)
+{
+    sam* ptr_memory = nullptr;
+
+    guarded([&]() {
+        if (storage != SAM_STORAGE_DENSE && storage != SAM_STORAGE_BLOCKS) throw std::invalid_argument("unknown storage");
+        if (nc == 0 || nf == 0) throw std::invalid_argument("the network needs at least one cluster of one fanal");
+        ptr_memory = new sam(nc, nf, storage == SAM_STORAGE_BLOCKS ? sam::storage_blocks : sam::storage_dense);
+    });
+
+    return reinterpret_cast<sam_network*>(ptr_memory);
+}
+
+void sam_destroy(sam_network* network)
+{
+    delete memory(network);
+}
+
+size_t sam_clusters(const sam_network* network)
+{
+    return memory(network)->clusters();
+}
+
+size_t sam_fanals(const sam_network* network)
+{
+    return memory(network)->fanals();
+}
+
+// The arrays are viewed in place by a dataset bounded by the network, which checks them once.
+int sam_learn(sam_network* network, size_t count,
+              const uint64_t* offsets, const uint32_t* elements, const uint32_t* clusters)
+{
+    return guarded([&]() {
+        dataset messages(count, offsets, elements, clusters, memory(network)->clusters(), memory(network)->fanals());
+        memory(network)->learn(messages);
+    });
+}
+
+int sam_recall_blind(sam_network* network, size_t count,
+                     const uint64_t* offsets, const uint32_t* elements, const uint32_t* clusters,
+                     uint32_t* retrieved)
+{
+    return guarded([&]() {
+        dataset queries(count, offsets, elements, clusters, memory(network)->clusters(), memory(network)->fanals());
+        memory(network)->recall_blind_flat(queries, retrieved);
+    });
+}
+
+int sam_recall_guided(sam_network* network, size_t count,
+                      const uint64_t* offsets, const uint32_t* elements, const uint32_t* clusters,
+                      const uint64_t* offsets_all, const uint32_t* clusters_all,
+                      size_t max_it, uint32_t* retrieved)
+{
+    return guarded([&]() {
+        dataset queries(count, offsets, elements, clusters, memory(network)->clusters(), memory(network)->fanals());
+        memory(network)->recall_guided_flat(queries, offsets_all, clusters_all, max_it, retrieved);
+    });
+}
+
+void sam_reset(sam_network* network)
+{
+    memory(network)->reset();
+}
+
+int sam_save(const sam_network* network, const char* filename)
+{
+    return guarded([&]() {
+        if (!memory(network)->save(filename)) throw std::runtime_error(std::string("cannot save the network to ") + filename);
+    });
+}
+
+int sam_load(sam_network* network, const char* filename)
+{
+    return guarded([&]() {
+        if (!memory(network)->load(filename)) throw std::runtime_error(std::string("cannot load the network from ") + filename);
+    });
+}
+
+const char* sam_error(void)
+{
+    return str_error.c_str();
+}
@@ -0,0 +1,187 @@
+/**
+ * @file dataset.cpp
+ * @brief memory mapped message file
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "dataset.hpp"
+
+static const char DATASET_MAGIC[4] = {'S', 'A', 'M', 'D'};
+
+struct dataset_header
+{
+    char     magic[4];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t nelements;
+    uint64_t nc;
+    uint64_t nf;
+};
+
+dataset::dataset(const char* filename) : ptr_map(nullptr), uint_map_size(0)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) throw std::runtime_error(std::string("cannot open the message file ") + filename);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(dataset_header))
+    {
+        close(fd);
+        throw std::runtime_error(std::string("invalid message file ") + filename);
+    }
+
+    uint_map_size = st.st_size;
+    ptr_map = mmap(nullptr, uint_map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (ptr_map == MAP_FAILED)
+    {
+        ptr_map = nullptr;
+        throw std::runtime_error(std::string("cannot map the message file ") + filename);
+    }
+
+    // the messages are mostly read in order.
+    madvise(ptr_map, uint_map_size, MADV_SEQUENTIAL);
+
+    const dataset_header* header = (const dataset_header*)ptr_map;
+    size_t uint_num_arrays = (header->flags & DATASET_CLUSTERS) ? 2 : 1;
+
+    // the sizes are checked before computing the array bounds to rule out overflows.
+    bool bool_valid = std::memcmp(header->magic, DATASET_MAGIC, sizeof(DATASET_MAGIC)) == 0 &&
+                      header->version == DATASET_VERSION &&
+                      header->count < uint_map_size / sizeof(uint64_t) &&
+                      header->nelements < uint_map_size / sizeof(uint32_t) &&
+                      sizeof(dataset_header) + (header->count + 1) * sizeof(uint64_t) +
+                      uint_num_arrays * header->nelements * sizeof(uint32_t) == uint_map_size;
+
+    if (bool_valid)
+    {
+        uint_count    = header->count;
+        uint_clusters = header->nc;
+        uint_fanals   = header->nf;
+        ptr_offsets   = (const uint64_t*)(header + 1);
+        ptr_elements  = (const uint32_t*)(ptr_offsets + uint_count + 1);
+        ptr_clusters  = uint_num_arrays == 2 ? ptr_elements + header->nelements : nullptr;
+
+        bool_valid = valid(header->nelements);
+    }
+
+    if (!bool_valid)
+    {
+        munmap(ptr_map, uint_map_size);
+        ptr_map = nullptr;
+        throw std::runtime_error(std::string("malformed message file ") + filename);
+    }
+}
+
+dataset::dataset(size_t count, const uint64_t* offsets, const uint32_t* elements, const uint32_t* clusters, size_t nc, size_t nf)
+    : ptr_map(nullptr), uint_map_size(0), ptr_offsets(offsets), ptr_elements(elements), ptr_clusters(clusters),
+      uint_count(count), uint_clusters(nc), uint_fanals(nf)
+{
+    if (ptr_offsets == nullptr || (ptr_elements == nullptr && ptr_offsets[uint_count] > 0) || !valid(ptr_offsets[uint_count]))
+        throw std::invalid_argument("malformed messages");
+}
+
+// The bounds (given by the header of a file) are checked once, so the users can rely on them.
+// A message holds at most one element per cluster: its clique has one fanal in each of them.
+bool dataset::valid(size_t uint_num_elements) const
+{
+    bool bool_valid = ptr_offsets[0] == 0 && ptr_offsets[uint_count] == uint_num_elements;
+
+    for (size_t uint_msg_indx = 0; bool_valid && uint_msg_indx < uint_count; uint_msg_indx++)
+    {
+        bool_valid = ptr_offsets[uint_msg_indx] <= ptr_offsets[uint_msg_indx + 1] &&
+                     (ptr_clusters != nullptr || length(uint_msg_indx) <= uint_clusters);
+    }
+
+    for (size_t uint_indx = 0; bool_valid && uint_indx < uint_num_elements; uint_indx++)
+    {
+        bool_valid = ptr_elements[uint_indx] >= 1 && ptr_elements[uint_indx] <= uint_fanals &&
+                     (ptr_clusters == nullptr || ptr_clusters[uint_indx] < uint_clusters);
+    }
+
+    std::vector<uint32_t> vec_message_clusters;
+
+    for (size_t uint_msg_indx = 0; bool_valid && ptr_clusters != nullptr && uint_msg_indx < uint_count; uint_msg_indx++)
+    {
+        vec_message_clusters.assign(ptr_clusters + ptr_offsets[uint_msg_indx], ptr_clusters + ptr_offsets[uint_msg_indx + 1]);
+        std::sort(vec_message_clusters.begin(), vec_message_clusters.end());
+
+        bool_valid = std::adjacent_find(vec_message_clusters.begin(), vec_message_clusters.end()) == vec_message_clusters.end();
+    }
+
+    return bool_valid;
+}
+
+dataset::~dataset()
+{
+    if (ptr_map != nullptr) munmap(ptr_map, uint_map_size);
+}
+
+bool dataset::write(const char* filename,
+                    const std::vector<std::vector<size_t>>& vec_message,
+                    const std::vector<std::vector<size_t>>& vec_clusters)
+{
+    bool bool_clusters = !vec_clusters.empty();
+
+    if (bool_clusters && vec_clusters.size() != vec_message.size()) return false;
+
+    dataset_header header;
+    std::memcpy(header.magic, DATASET_MAGIC, sizeof(DATASET_MAGIC));
+    header.version   = DATASET_VERSION;
+    header.flags     = bool_clusters ? DATASET_CLUSTERS : 0;
+    header.reserved  = 0;
+    header.count     = vec_message.size();
+    header.nelements = 0;
+    header.nc        = 0;
+    header.nf        = 0;
+
+    std::vector<uint64_t> vec_offsets(1, 0);
+    std::vector<uint32_t> vec_elements;
+    std::vector<uint32_t> vec_element_clusters;
+
+    for (size_t uint_msg_indx = 0; uint_msg_indx < vec_message.size(); uint_msg_indx++)
+    {
+        size_t uint_num_msg_clusters = vec_message[uint_msg_indx].size();
+
+        if (bool_clusters && vec_clusters[uint_msg_indx].size() != uint_num_msg_clusters) return false;
+
+        for (size_t uint_cluster = 0; uint_cluster < uint_num_msg_clusters; uint_cluster++)
+        {
+            size_t uint_element = vec_message[uint_msg_indx][uint_cluster];
+            size_t uint_index   = bool_clusters ? vec_clusters[uint_msg_indx][uint_cluster] : uint_cluster;
+
+            vec_elements.push_back(uint_element);
+            if (bool_clusters) vec_element_clusters.push_back(uint_index);
+
+            header.nf = std::max<uint64_t>(header.nf, uint_element);
+            header.nc = std::max<uint64_t>(header.nc, uint_index + 1);
+        }
+
+        vec_offsets.push_back(vec_elements.size());
+    }
+
+    header.nelements = vec_elements.size();
+
+    std::ofstream fs_dataset(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!fs_dataset) return false;
+
+    fs_dataset.write((const char*)&header, sizeof(header));
+    fs_dataset.write((const char*)vec_offsets.data(), vec_offsets.size() * sizeof(uint64_t));
+    fs_dataset.write((const char*)vec_elements.data(), vec_elements.size() * sizeof(uint32_t));
+    fs_dataset.write((const char*)vec_element_clusters.data(), vec_element_clusters.size() * sizeof(uint32_t));
+
+    return (bool)fs_dataset;
+}
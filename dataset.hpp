@@ -0,0 +1,122 @@
+/**
+ * @file dataset.hpp
+ * @brief memory mapped message file
+ *
+ * A message file holds a header and flat arrays, so that it is used in place
+ * from a read-only memory mapping without any parsing:
+ *
+ * | field      | type                 | content                                            |
+ * |------------|----------------------|----------------------------------------------------|
+ * | magic      | char[4]              | "SAMD"                                             |
+ * | version    | uint32               | DATASET_VERSION                                    |
+ * | flags      | uint32               | DATASET_CLUSTERS if the clusters are given         |
+ * | reserved   | uint32               | zero                                               |
+ * | count      | uint64               | the number of messages                             |
+ * | nelements  | uint64               | the total number of elements                       |
+ * | nc         | uint64               | the number of clusters the messages span           |
+ * | nf         | uint64               | the largest element (size of the alphabet)         |
+ * | offsets    | uint64[count + 1]    | the first element of each message (and nelements)  |
+ * | elements   | uint32[nelements]    | the elements (from one to nf)                      |
+ * | clusters   | uint32[nelements]    | the cluster of each element (DATASET_CLUSTERS)     |
+ *
+ * The values are in the byte order of the host. Without the clusters, the
+ * element j of a message belongs to the cluster j.
+ *
+ * The same arrays held in memory by the caller are viewed in place as well.
+ */
+#ifndef __DATASET_HPP__
+#define __DATASET_HPP__
+
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+
+#define DATASET_VERSION     1
+#define DATASET_CLUSTERS    1   // the file holds the cluster of each element
+
+/**
+ * @class dataset
+ *
+ * @brief read-only view of a message file mapped in memory
+ */
+class dataset
+{
+
+  public:
+    /**
+     * @brief maps a message file.
+     * @param filename the message file.
+     *
+     * It throws std::runtime_error if the file cannot be mapped or is malformed.
+     */
+    explicit dataset(const char* filename);
+
+    /**
+     * @brief views the arrays of a message file held by the caller (not copied).
+     * @param count the number of messages.
+     * @param offsets the first element of each message and the total number of elements (count + 1).
+     * @param elements the elements (from one to nf).
+     * @param clusters the cluster of each element, or nullptr for the element positions.
+     * @param nc the number of clusters the messages may span.
+     * @param nf the largest element the messages may hold.
+     *
+     * The arrays must outlive the view. It throws std::invalid_argument if they are malformed,
+     * e.g. if a message holds two elements in the same cluster.
+     */
+    dataset(size_t count, const uint64_t* offsets, const uint32_t* elements, const uint32_t* clusters, size_t nc, size_t nf);
+
+    //! destructor (unmaps the file)
+    ~dataset();
+
+    dataset(const dataset&) = delete;
+    dataset& operator=(const dataset&) = delete;
+
+    /**
+     * @brief writes a message file.
+     * @param filename the message file.
+     * @param vec_message the messages.
+     * @param vec_clusters the clusters of the message elements, or none for the element positions.
+     * @return true on success.
+     */
+    static bool write(const char* filename,
+                      const std::vector<std::vector<size_t>>& vec_message,
+                      const std::vector<std::vector<size_t>>& vec_clusters = std::vector<std::vector<size_t>>());
+
+    //! the number of messages.
+    size_t size() const { return uint_count; }
+
+    //! the number of elements of message 'i'.
+    size_t length(size_t i) const { return ptr_offsets[i + 1] - ptr_offsets[i]; }
+
+    //! the element 'j' of message 'i'.
+    size_t element(size_t i, size_t j) const { return ptr_elements[ptr_offsets[i] + j]; }
+
+    //! the cluster of the element 'j' of message 'i'.
+    size_t cluster(size_t i, size_t j) const { return ptr_clusters ? ptr_clusters[ptr_offsets[i] + j] : j; }
+
+    //! true if the file holds the clusters of the elements.
+    bool has_clusters() const { return ptr_clusters != nullptr; }
+
+    //! the number of clusters the messages span.
+    size_t clusters() const { return uint_clusters; }
+
+    //! the largest element of the messages.
+    size_t fanals() const { return uint_fanals; }
+
+  private:
+    // checks the offsets, bounds the elements and the clusters and rejects a cluster repeated in a message.
+    bool valid(size_t uint_num_elements) const;
+
+    void*           ptr_map;
+    size_t          uint_map_size;
+
+    const uint64_t* ptr_offsets;
+    const uint32_t* ptr_elements;
+    const uint32_t* ptr_clusters;
+
+    size_t          uint_count;
+    size_t          uint_clusters;
+    size_t          uint_fanals;
+};
+
+#endif
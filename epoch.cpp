@@ -0,0 +1,140 @@
+/**
+ * @file epoch.cpp
+ * @brief epoch based snapshot isolation of the connections
+ */
+
+#include <thread>
+#include <functional>
+#include <algorithm>
+
+#include "epoch.hpp"
+
+#define EPOCH_FREE  UINT64_MAX // the value of a free reader slot
+
+epoch_domain::epoch_domain() : epoch_next(0), epoch_committed(0), epoch_reclaimed(0)
+{
+    for (size_t slot = 0; slot < EPOCH_NUM_READERS; slot++)
+    {
+        readers[slot].epoch.store(EPOCH_FREE);
+    }
+}
+
+size_t epoch_domain::enter(uint64_t& snapshot)
+{
+    size_t slot_first = std::hash<std::thread::id>()(std::this_thread::get_id()) % EPOCH_NUM_READERS;
+    size_t slot       = EPOCH_NUM_READERS;
+
+    while (slot == EPOCH_NUM_READERS)
+    {
+        for (size_t indx = 0; indx < EPOCH_NUM_READERS; indx++)
+        {
+            size_t   slot_try = (slot_first + indx) % EPOCH_NUM_READERS;
+            uint64_t expected = EPOCH_FREE;
+
+            if (readers[slot_try].epoch.compare_exchange_strong(expected, epoch_committed.load()))
+            {
+                slot = slot_try;
+                break;
+            }
+        }
+
+        if (slot == EPOCH_NUM_READERS) std::this_thread::yield();
+    }
+
+    // The snapshot is valid once the slot holds the epoch that is still the last
+    // committed one; a concurrent reclaim then either sees the slot or a later commit.
+    while (true)
+    {
+        uint64_t epoch     = readers[slot].epoch.load();
+        uint64_t committed = epoch_committed.load();
+
+        if (epoch == committed)
+        {
+            snapshot = epoch;
+            return slot;
+        }
+
+        readers[slot].epoch.store(committed);
+    }
+}
+
+void epoch_domain::leave(size_t slot)
+{
+    readers[slot].epoch.store(EPOCH_FREE, std::memory_order_release);
+}
+
+uint64_t epoch_domain::begin()
+{
+    uint64_t epoch = epoch_next.fetch_add(1) + 1;
+
+    // the tags of the epochs after the last rewritten one must stay unambiguous.
+    while (epoch > epoch_reclaimed.load(std::memory_order_acquire) + EPOCH_WINDOW)
+    {
+        reclaim();
+        std::this_thread::yield();
+    }
+
+    return epoch;
+}
+
+void epoch_domain::commit(uint64_t epoch, std::vector<unsigned char*>& vec_log)
+{
+    while (epoch_committed.load(std::memory_order_acquire) != epoch - 1)
+    {
+        std::this_thread::yield();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_logs);
+        map_logs[epoch].swap(vec_log);
+    }
+
+    epoch_committed.store(epoch);
+
+    reclaim();
+}
+
+void epoch_domain::clear()
+{
+    std::lock_guard<std::mutex> lock(mtx_logs);
+    map_logs.clear();
+}
+
+void epoch_domain::forget(const unsigned char* ptr, size_t size)
+{
+    std::lock_guard<std::mutex> lock(mtx_logs);
+
+    for (std::map<uint64_t, std::vector<unsigned char*>>::iterator itl = map_logs.begin(); itl != map_logs.end(); itl++)
+    {
+        itl->second.erase(std::remove_if(itl->second.begin(), itl->second.end(), [ptr, size](const unsigned char* ptr_log) {
+            return ptr_log >= ptr && ptr_log < ptr + size;
+        }), itl->second.end());
+    }
+}
+
+void epoch_domain::reclaim()
+{
+    std::unique_lock<std::mutex> lock(mtx_logs, std::try_to_lock);
+
+    // another writer is already reclaiming.
+    if (!lock.owns_lock()) return;
+
+    uint64_t epoch_grace = epoch_committed.load();
+
+    for (size_t slot = 0; slot < EPOCH_NUM_READERS; epoch_grace = std::min(epoch_grace, readers[slot++].epoch.load()));
+
+    std::map<uint64_t, std::vector<unsigned char*>>::iterator itl = map_logs.begin();
+
+    while (itl != map_logs.end() && itl->first <= epoch_grace)
+    {
+        for (std::vector<unsigned char*>::iterator itc = itl->second.begin(); itc != itl->second.end(); itc++)
+        {
+            __atomic_store_n(*itc, 1, __ATOMIC_RELAXED);
+        }
+
+        itl = map_logs.erase(itl);
+    }
+
+    if (epoch_grace > epoch_reclaimed.load(std::memory_order_relaxed))
+        epoch_reclaimed.store(epoch_grace, std::memory_order_release);
+}
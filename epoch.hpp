@@ -0,0 +1,201 @@
+/**
+ * @file epoch.hpp
+ * @brief epoch based snapshot isolation of the connections
+ *
+ * A connection of the weight tensor is a byte that is either zero (no connection),
+ * one (a connection that every reader sees) or the tag of the epoch that created it.
+ *
+ * A writer reserves an epoch, tags the connections it creates with the epoch
+ * (lowest epoch wins) and records them in a log. The epochs are committed in order.
+ * A reader takes a snapshot of the last committed epoch and only sees the connections
+ * of the epochs up to its snapshot, so it never observes a partially learned message
+ * and it never waits for the writers.
+ *
+ * The reads are not wait-free for all that: a reader takes one of EPOCH_NUM_READERS
+ * slots and yields until one frees up when they are all taken, so at most that many
+ * readers run at once. A writer waits in begin() while a reader holds a snapshot more
+ * than EPOCH_WINDOW epochs old, so a long reader stalls every writer of its domain.
+ *
+ * The tags are recycled: once no reader holds a snapshot older than a committed
+ * epoch (a grace period), the logged connections of the epoch are rewritten to one.
+ * A writer waits for the grace period when its epoch would be too far ahead of
+ * the last rewritten epoch to keep the tags unambiguous.
+ */
+#ifndef __EPOCH_HPP__
+#define __EPOCH_HPP__
+
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+
+#define EPOCH_NUM_TAGS      254 // the number of distinct epoch tags (byte values 2..255)
+#define EPOCH_WINDOW        127 // the maximum number of epochs ahead of the last rewritten one
+#define EPOCH_NUM_READERS   128 // the maximum number of concurrent readers
+
+class epoch_domain
+{
+
+  public:
+    epoch_domain();
+
+    epoch_domain(const epoch_domain&) = delete;
+    epoch_domain& operator=(const epoch_domain&) = delete;
+
+    //! the tag of the connections created in epoch 'epoch'.
+    static unsigned char tag(uint64_t epoch)
+    {
+        return 2 + epoch % EPOCH_NUM_TAGS;
+    }
+
+    //! true if the connection 'value' exists in the snapshot 'epoch' (the tagged epoch lies within the window around it).
+    static bool visible(unsigned char value, uint64_t epoch)
+    {
+        return value == 1 ||
+               (value > 1 && (epoch % EPOCH_NUM_TAGS + EPOCH_NUM_TAGS - (value - 2)) % EPOCH_NUM_TAGS < EPOCH_WINDOW);
+    }
+
+    /**
+     * @brief registers a reader.
+     * @param snapshot set to the epoch of the snapshot of the reader.
+     * @return the slot of the reader to be released by leave().
+     *
+     * It yields until a slot is free if EPOCH_NUM_READERS readers are registered.
+     */
+    size_t enter(uint64_t& snapshot);
+
+    //! unregisters a reader.
+    void leave(size_t slot);
+
+    //! reserves the epoch of a writer (it waits for the readers of the snapshots more than EPOCH_WINDOW epochs old).
+    uint64_t begin();
+
+    /**
+     * @brief creates a connection in the epoch of a writer.
+     * @param ptr the connection.
+     * @param epoch the epoch returned by begin().
+     * @param vec_log the connections created by the writer.
+     */
+    static void set(unsigned char* ptr, uint64_t epoch, std::vector<unsigned char*>& vec_log)
+    {
+        unsigned char value = __atomic_load_n(ptr, __ATOMIC_RELAXED);
+
+        // an existing connection of an earlier (or the same) epoch is kept.
+        while (!visible(value, epoch))
+        {
+            if (__atomic_compare_exchange_n(ptr, &value, tag(epoch), true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                vec_log.push_back(ptr);
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief commits the epoch of a writer and publishes its connections.
+     *
+     * The commits are ordered so the caller waits for the writers of the earlier epochs.
+     */
+    void commit(uint64_t epoch, std::vector<unsigned char*>& vec_log);
+
+    //! drops the logs of all the epochs (the connections are erased or rewritten by the caller).
+    void clear();
+
+    //! drops the logged connections in [ptr, ptr + size) (the domain may be shared by many networks).
+    void forget(const unsigned char* ptr, size_t size);
+
+  private:
+    // rewrites the connections of the epochs that no reader can tell apart anymore.
+    void reclaim();
+
+    // a reader slot fills a cache line so the readers do not share lines.
+    struct reader_slot
+    {
+        std::atomic<uint64_t> epoch;
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    reader_slot                                         readers[EPOCH_NUM_READERS];
+    std::atomic<uint64_t>                               epoch_next;      // the last reserved epoch
+    std::atomic<uint64_t>                               epoch_committed; // the last committed epoch
+    std::atomic<uint64_t>                               epoch_reclaimed; // the last rewritten epoch
+    std::mutex                                          mtx_logs;        // guards the logs (writers only)
+    std::map<uint64_t, std::vector<unsigned char*>>     map_logs;
+};
+
+/**
+ * @brief registers a reader for the lifetime of the object.
+ */
+class epoch_guard
+{
+
+  public:
+    explicit epoch_guard(epoch_domain& domain) : domain(domain)
+    {
+        slot = domain.enter(snapshot);
+    }
+
+    ~epoch_guard()
+    {
+        domain.leave(slot);
+    }
+
+    //! the epoch of the snapshot.
+    uint64_t epoch() const { return snapshot; }
+
+  private:
+    epoch_domain&   domain;
+    size_t          slot;
+    uint64_t        snapshot;
+};
+
+/**
+ * @brief reserves the epoch of a writer for the lifetime of the object.
+ *
+ * The epoch is committed by commit() or, if the writer unwinds before, by the
+ * destructor with the connections logged so far, so the writers of the later
+ * epochs never wait for it.
+ */
+class epoch_writer
+{
+
+  public:
+    explicit epoch_writer(epoch_domain& domain) : domain(domain), committed(false)
+    {
+        reserved = domain.begin();
+    }
+
+    ~epoch_writer()
+    {
+        if (!committed) domain.commit(reserved, vec_log);
+    }
+
+    epoch_writer(const epoch_writer&) = delete;
+    epoch_writer& operator=(const epoch_writer&) = delete;
+
+    //! creates a connection in the epoch (see epoch_domain::set()).
+    void set(unsigned char* ptr)
+    {
+        epoch_domain::set(ptr, reserved, vec_log);
+    }
+
+    //! commits the epoch and publishes its connections.
+    void commit()
+    {
+        committed = true;
+        domain.commit(reserved, vec_log);
+    }
+
+    //! the reserved epoch.
+    uint64_t epoch() const { return reserved; }
+
+  private:
+    epoch_domain&               domain;
+    bool                        committed;
+    uint64_t                    reserved;
+    std::vector<unsigned char*> vec_log;
+};
+
+#endif
@@ -28,8 +28,11 @@
 #include <iomanip>
 #include <ctime>
 #include <cstring>
+#include <sstream>
 
 #include "sam.hpp"
+#include "shard.hpp"
+#include "perf.hpp"
 
 #define CWIDTH          15
 #define USAGE_STDERR    std::cerr << std::left << std::setw(CWIDTH)
@@ -54,9 +57,22 @@ size_t num_it           = 4;   // number of iterations
 size_t num_mc           = 500; // The observed number of errors
 
 const char* filename    = nullptr;
+const char* shard_paths = nullptr; // comma separated socket paths of running shards
 int         prio        = 0;
-
-int  run(void);
+size_t      nshards     = 0;       // number of local shard processes (0 to disable sharding)
+bool        blocks      = false;   // compressed block storage of the connections
+const char* learn_file  = nullptr; // message file to learn (see dataset.hpp)
+const char* test_file   = nullptr; // message file to recall (defaults to 'learn_file')
+const char* write_file  = nullptr; // message file to write random messages into
+
+// The counters are opened before any thread is started so that they count the recall threads.
+perf_counter dtlb_misses(perf_counter::event_dtlb_misses);
+perf_counter page_faults(perf_counter::event_page_faults);
+
+template <typename memory_t> int run(memory_t& memory);
+void print_events(size_t num_recalls, uint64_t num_dtlb_misses, uint64_t num_page_faults);
+int  run_file(sam& memory);
+int  write_messages();
 int  setprio(int);
 void usage(const char* progname);
 
@@ -73,11 +89,17 @@ int main(int argc, char **argv)
             {"nmc", required_argument, 0, 'o'},
             {"csv", required_argument, 0, 'r'},
             {"prio", required_argument, 0, 'p'},
+            {"shards", required_argument, 0, 's'},
+            {"connect", required_argument, 0, 'k'},
+            {"blocks", no_argument, 0, 'b'},
+            {"learn", required_argument, 0, 'l'},
+            {"test", required_argument, 0, 't'},
+            {"write", required_argument, 0, 'w'},
             {"help", no_argument, 0, 'h'},
             {0, 0, 0, 0},
         };
 
-    const char *const short_opts = "hm:x:i:f:c:e:o:r:p:";
+    const char *const short_opts = "hbm:x:i:f:c:e:o:r:p:s:k:l:t:w:";
 
     while (true)
     {
@@ -109,6 +131,27 @@ int main(int argc, char **argv)
         case 'p':
             prio         = std::stoi(optarg);
             break;
+        case 's':
+            try { nshards = std::stoi(optarg);} catch (...) {/*don't care*/}
+            break;
+        case 'k':
+            shard_paths  = optarg;
+            break;
+        case 'b':
+            blocks       = true;
+            break;
+        case 'e':
+            try { num_unknowns = std::stoi(optarg);} catch (...) {/*don't care*/}
+            break;
+        case 'l':
+            learn_file   = optarg;
+            break;
+        case 't':
+            test_file    = optarg;
+            break;
+        case 'w':
+            write_file   = optarg;
+            break;
         case 'h': // -h or --help
             usage(argv[0]);
             return EXIT_SUCCESS;
@@ -119,6 +162,11 @@ int main(int argc, char **argv)
         }
     }
 
+    if (write_file != nullptr)
+    {
+        std::srand(std::time(nullptr));
+        return write_messages();
+    }
 
     if (filename == nullptr)
     {
@@ -148,7 +196,69 @@ int main(int argc, char **argv)
         }
     }
 
-    return run();
+    if (test_file != nullptr && learn_file == nullptr)
+    {
+        usage(argv[0]);
+
+        std::cerr << std::endl << "error: --test requires --learn." << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    if (learn_file != nullptr && (shard_paths != nullptr || nshards > 0))
+    {
+        std::cerr << "error: the message files require a local network." << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    std::srand(std::time(nullptr));
+
+    try
+    {
+        if (shard_paths != nullptr)
+        {
+            std::vector<std::string> vec_paths;
+            std::stringstream ss_paths(shard_paths);
+            std::string str_path;
+
+            while (std::getline(ss_paths, str_path, ','))
+                vec_paths.push_back(str_path);
+
+            sam_sharded memory(vec_paths);
+            nc = memory.clusters();
+            nf = memory.fanals();
+            return run(memory);
+        }
+
+        if (nshards > 0)
+        {
+            sam_sharded memory(nc, nf, nshards);
+            return run(memory);
+        }
+
+        sam memory(nc, nf, blocks ? sam::storage_blocks : sam::storage_dense);
+        int ret = learn_file != nullptr ? run_file(memory) : run(memory);
+
+        std::cout << "connections memory: " << memory.bytes() << " bytes" << std::endl;
+
+        size_t huge_reserved, huge_transparent;
+        topology_huge(huge_reserved, huge_transparent);
+        std::cout << "huge pages: " << huge_reserved << " bytes reserved, "
+                  << huge_transparent << " bytes transparent" << std::endl;
+
+        sam::numa_counters numa = memory.numa();
+        std::cout << "numa nodes: " << numa.nodes
+                  << ", local row scans: " << numa.local
+                  << ", remote row scans: " << numa.remote << std::endl;
+
+        return ret;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
 }
 
 void usage(const char* progname)
@@ -162,6 +272,27 @@ void usage(const char* progname)
     USAGE_STDERR << "-f | --nf "   << "number of fanals in each cluster." << std::endl;
     USAGE_STDERR << "-p | --prio " << "set process priority (-20 is the highest and 0 is the lowest)." << std::endl;
     USAGE_STDERR << "-r | --csv "  << "the results' file name in CSV format." << std::endl;
+    USAGE_STDERR << "-s | --shards "  << "spread the clusters over local shard processes." << std::endl;
+    USAGE_STDERR << "-k | --connect " << "comma separated socket paths of running shards (see sam-serve --range)." << std::endl;
+    USAGE_STDERR << "-b | --blocks "  << "store the connections in compressed blocks (large alphabets)." << std::endl;
+    USAGE_STDERR << "-l | --learn "   << "learn the messages of a message file instead of random messages." << std::endl;
+    USAGE_STDERR << "-t | --test "    << "recall the messages of a message file (defaults to the learned one)." << std::endl;
+    USAGE_STDERR << "-e | --ne "      << "number of unknown elements of the recalled messages." << std::endl;
+    USAGE_STDERR << "-w | --write "   << "write nmax random messages (and their clusters) into a message file and exit." << std::endl;
+}
+
+// This routine prints the mean number of events per recall (n/a if the event cannot be counted).
+void print_events(size_t num_recalls, uint64_t num_dtlb_misses, uint64_t num_page_faults)
+{
+    if (dtlb_misses.available() && num_recalls > 0)
+        std::cout << std::setw(CWIDTH) << (double)num_dtlb_misses / num_recalls;
+    else
+        std::cout << std::setw(CWIDTH) << "n/a";
+
+    if (page_faults.available() && num_recalls > 0)
+        std::cout << std::setw(CWIDTH) << (double)num_page_faults / num_recalls;
+    else
+        std::cout << std::setw(CWIDTH) << "n/a";
 }
 
 int setprio(int prio)
@@ -207,14 +338,10 @@ int setprio(int prio)
     return ret;
 }
 
-int run(void)
+template <typename memory_t> int run(memory_t& memory)
 {
-    std::srand(std::time(nullptr));
-
     size_t num_step = (max_num - min_num) / num_steps;
 
-    sam memory(nc, nf);
-
     std::ofstream fs_results;
     fs_results.open(filename, std::ios::out);
 
@@ -226,7 +353,8 @@ int run(void)
 
     fs_results << "ntrials,nmsgs,peg,peb" << std::endl;
     std::cout << std::setw(CWIDTH) << "ntrials" << std::setw(CWIDTH) << "nmsgs";
-    std::cout << std::setw(CWIDTH) << "peg" << std::setw(CWIDTH) << "peb" << std::endl;
+    std::cout << std::setw(CWIDTH) << "peg" << std::setw(CWIDTH) << "peb";
+    std::cout << std::setw(CWIDTH) << "dtlb/recall" << std::setw(CWIDTH) << "faults/recall" << std::endl;
 
     size_t num_clusters;
     size_t rnd_index;
@@ -247,7 +375,13 @@ int run(void)
         size_t mindx                   = 0;
         size_t mtotal                  = 0;
         size_t mc_trials               = 0;
-        std::vector<std::vector<size_t>> vec_resp, vec_resp_sorted;
+        uint64_t num_dtlb_misses       = 0;
+        uint64_t num_page_faults       = 0;
+
+        // the expected and the retrieved messages of a chunk, aligned to the clusters of the messages.
+        cluster_slots slots(nc);
+        std::vector<size_t> vec_offsets, vec_expected, vec_guided, vec_blind;
+        std::vector<bool> vec_errors;
 
         std::cout << std::endl;
 
@@ -279,7 +413,7 @@ int run(void)
             vec_partial_clusters = std::vector<std::vector<size_t>>(num_messages, std::vector<size_t>(0));
 
             size_t num_remainders;
-            size_t remainder_counter;
+            size_t remainder_counter = 0;
 
             for (size_t indx = 0; indx < num_messages; indx++)
             {
@@ -299,25 +433,52 @@ int run(void)
                 remainder_counter = 0;
             }
 
+            dtlb_misses.start();
+            page_faults.start();
+
+            // The messages are recalled in chunks that cannot hold more guided errors than the ones
+            // left to observe, so that a chunk ends where a message by message count would stop.
             while (errors_guided < num_mc && mindx < num_messages)
             {
+                size_t num_chunk = std::min(num_mc - errors_guided, num_messages - mindx);
+
+                vec_offsets.assign(1, 0);
+                vec_expected.clear();
 
-                vec_resp = memory.recall_guided(vec_partial_messages[mindx], vec_partial_clusters[mindx], vec_clusters[mindx], num_it);
-                vec_resp_sorted = sort_clusters(vec_resp, vec_clusters[mindx]);
-                if (vec_resp_sorted[0] != vec_messages[mindx]) errors_guided++;
+                for (size_t indx = mindx; indx < mindx + num_chunk; indx++)
+                {
+                    vec_expected.insert(vec_expected.end(), vec_messages[indx].begin(), vec_messages[indx].end());
+                    vec_offsets.push_back(vec_expected.size());
+                }
 
-                vec_resp = memory.recall_blind(vec_partial_messages[mindx], vec_partial_clusters[mindx]);
-                vec_resp_sorted = sort_clusters(vec_resp, vec_clusters[mindx]);
-                if (vec_resp_sorted[0] != vec_messages[mindx]) errors_blind++;
+                vec_guided.resize(vec_expected.size());
+                vec_blind.resize(vec_expected.size());
 
-                mindx++;
-                mtotal++;
+                for (size_t indx = 0; indx < num_chunk; indx++)
+                {
+                    slots.assign(vec_clusters[mindx + indx]);
+                    memory.recall_guided(vec_partial_messages[mindx + indx], vec_partial_clusters[mindx + indx], vec_clusters[mindx + indx], num_it,
+                                         slots, vec_guided.data() + vec_offsets[indx]);
+                    memory.recall_blind(vec_partial_messages[mindx + indx], vec_partial_clusters[mindx + indx],
+                                        slots, vec_blind.data() + vec_offsets[indx]);
+                }
+
+                errors_guided += compare_messages(vec_offsets, vec_guided.data(), vec_expected.data(), vec_errors);
+                errors_blind  += compare_messages(vec_offsets, vec_blind.data(), vec_expected.data(), vec_errors);
+
+                mindx  += num_chunk;
+                mtotal += num_chunk;
 
                 // compute the error rate and send them to the output stream.
                 float_err_guided    = (float)errors_guided / mtotal;
                 float_err_blind     = (float)errors_blind / mtotal;
             }
 
+            dtlb_misses.stop();
+            page_faults.stop();
+            num_dtlb_misses += dtlb_misses.value();
+            num_page_faults += page_faults.value();
+
             if (mc_trials > 10 && errors_blind < 1.0e-5) break;
         }
 
@@ -327,6 +488,9 @@ int run(void)
                   << std::setw(CWIDTH) << float_err_guided
                   << std::setw(CWIDTH) << float_err_blind;
 
+        // a guided and a blind recall per message.
+        print_events(2 * mtotal, num_dtlb_misses, num_page_faults);
+
         // writes the error rates in the file.
         fs_results  << mc_trials << ","
                     << num_messages << ","
@@ -339,3 +503,121 @@ int run(void)
 
     return EXIT_SUCCESS;
 }
+
+// This routine writes 'max_num' random messages, drawn as the messages of run, and
+// their random clusters into a message file (see dataset::write).
+int write_messages()
+{
+    std::vector<std::vector<size_t>> vec_messages(max_num, std::vector<size_t>(0));
+
+    for (size_t indx = 0; indx < max_num; indx++)
+    {
+        size_t num_clusters = cmin + randint(cmax - cmin + 1) - 1;
+        vec_messages[indx].reserve(num_clusters);
+        for (size_t jndx = 0; jndx < num_clusters; jndx++)
+        {
+            vec_messages[indx].push_back(randint(nf));
+        }
+    }
+
+    if (cmax > nc || !dataset::write(write_file, vec_messages, random_clusters(vec_messages, nc)))
+    {
+        std::cerr << "error: cannot write the message file " << write_file << "." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "wrote " << max_num << " messages into " << write_file << std::endl;
+
+    return EXIT_SUCCESS;
+}
+
+// This routine learns the messages of a message file and recalls the messages of
+// another one (or the same) whose last 'num_unknowns' elements are erased.
+int run_file(sam& memory)
+{
+    std::ofstream fs_results;
+    fs_results.open(filename, std::ios::out);
+
+    if (!fs_results)
+    {
+        std::cerr << "failed to open the results file." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    dataset data_learn(learn_file);
+
+    std::clock_t learn_start = std::clock();
+    memory.learn(data_learn);
+    double learn_time = (double)(std::clock() - learn_start) / CLOCKS_PER_SEC;
+
+    dataset data_test(test_file != nullptr ? test_file : learn_file);
+
+    dtlb_misses.start();
+    page_faults.start();
+
+    std::vector<std::vector<std::vector<size_t>>> vec_guided = memory.recall_guided_batch(data_test, num_unknowns, num_it);
+    std::vector<std::vector<std::vector<size_t>>> vec_blind  = memory.recall_blind_batch(data_test, num_unknowns);
+
+    dtlb_misses.stop();
+    page_faults.stop();
+
+    // the retrieved messages are aligned to the clusters of the test messages and compared at once.
+    cluster_slots slots(memory.clusters());
+    std::vector<size_t> vec_offsets(1, 0), vec_expected, vec_clusters;
+    std::vector<bool> vec_errors;
+
+    for (size_t indx = 0; indx < data_test.size(); indx++)
+    {
+        for (size_t jndx = 0; jndx < data_test.length(indx); jndx++)
+        {
+            vec_expected.push_back(data_test.element(indx, jndx));
+        }
+
+        vec_offsets.push_back(vec_expected.size());
+    }
+
+    std::vector<size_t> vec_guided_aligned(vec_expected.size()), vec_blind_aligned(vec_expected.size());
+
+    for (size_t indx = 0; indx < data_test.size(); indx++)
+    {
+        vec_clusters.resize(data_test.length(indx));
+
+        for (size_t jndx = 0; jndx < vec_clusters.size(); jndx++)
+        {
+            vec_clusters[jndx] = data_test.cluster(indx, jndx);
+        }
+
+        slots.assign(vec_clusters);
+        slots.align(vec_guided[indx], vec_guided_aligned.data() + vec_offsets[indx]);
+        slots.align(vec_blind[indx], vec_blind_aligned.data() + vec_offsets[indx]);
+    }
+
+    size_t errors_guided = compare_messages(vec_offsets, vec_guided_aligned.data(), vec_expected.data(), vec_errors);
+    size_t errors_blind  = compare_messages(vec_offsets, vec_blind_aligned.data(), vec_expected.data(), vec_errors);
+
+    float float_err_guided = data_test.size() ? (float)errors_guided / data_test.size() : 0;
+    float float_err_blind  = data_test.size() ? (float)errors_blind / data_test.size() : 0;
+
+    std::cout << std::setw(CWIDTH) << "nmsgs" << std::setw(CWIDTH) << "ntests";
+    std::cout << std::setw(CWIDTH) << "learn (s)";
+    std::cout << std::setw(CWIDTH) << "peg" << std::setw(CWIDTH) << "peb";
+    std::cout << std::setw(CWIDTH) << "dtlb/recall" << std::setw(CWIDTH) << "faults/recall" << std::endl;
+
+    std::cout << std::setprecision(5)
+              << std::setw(CWIDTH) << data_learn.size()
+              << std::setw(CWIDTH) << data_test.size()
+              << std::setw(CWIDTH) << learn_time
+              << std::setw(CWIDTH) << float_err_guided
+              << std::setw(CWIDTH) << float_err_blind;
+
+    print_events(2 * data_test.size(), dtlb_misses.value(), page_faults.value());
+    std::cout << std::endl;
+
+    fs_results << "nmsgs,ntests,peg,peb" << std::endl;
+    fs_results << data_learn.size() << ","
+               << data_test.size() << ","
+               << float_err_guided << ","
+               << float_err_blind << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file perf.cpp
+ * @brief event counters of the kernel (perf_event_open)
+ */
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "perf.hpp"
+
+perf_counter::perf_counter(event ev)
+{
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+
+    attr.size           = sizeof(attr);
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.inherit        = 1; // the threads started afterwards are counted as well
+
+    switch (ev)
+    {
+    case event_dtlb_misses:
+        attr.type   = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+    case event_page_faults:
+        attr.type   = PERF_TYPE_SOFTWARE;
+        attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+        break;
+    }
+
+    fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+perf_counter::~perf_counter()
+{
+    if (fd >= 0) close(fd);
+}
+
+void perf_counter::start()
+{
+    if (fd < 0) return;
+
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+void perf_counter::stop()
+{
+    if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+}
+
+uint64_t perf_counter::value() const
+{
+    uint64_t count = 0;
+
+    if (fd < 0 || read(fd, &count, sizeof(count)) != sizeof(count)) return 0;
+
+    return count;
+}
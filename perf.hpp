@@ -0,0 +1,50 @@
+/**
+ * @file perf.hpp
+ * @brief event counters of the kernel (perf_event_open)
+ *
+ * A counter counts the events of the thread that creates it and of the threads
+ * that this thread starts afterwards. The events may be unavailable, e.g. on a
+ * virtual machine without hardware counters or if perf_event_paranoid forbids them.
+ */
+#ifndef __PERF_HPP__
+#define __PERF_HPP__
+
+#include <cstdint>
+#include <cstdlib>
+
+class perf_counter
+{
+
+  public:
+    enum event
+    {
+        event_dtlb_misses,  //!< the data TLB load misses
+        event_page_faults,  //!< the page faults
+    };
+
+    //! opens a stopped counter of an event.
+    explicit perf_counter(event ev);
+
+    //! destructor (closes the counter)
+    ~perf_counter();
+
+    perf_counter(const perf_counter&) = delete;
+    perf_counter& operator=(const perf_counter&) = delete;
+
+    //! true if the event can be counted.
+    bool available() const { return fd >= 0; }
+
+    //! resets and starts the counter.
+    void start();
+
+    //! stops the counter.
+    void stop();
+
+    //! the number of events counted between start and stop (zero if unavailable).
+    uint64_t value() const;
+
+  private:
+    int fd;
+};
+
+#endif
@@ -0,0 +1,84 @@
+/**
+ * @file pool.cpp
+ * @brief pool of many small networks sharing one arena and one set of workers
+ */
+
+#include <new>
+#include <stdexcept>
+
+#include "pool.hpp"
+
+sam_pool::sam_pool(size_t capacity, size_t nthreads)
+    : uint_capacity(capacity), uint_used(0), workers(nthreads)
+{
+    ptr_arena = (unsigned char*)topology_alloc(uint_capacity, topology_node());
+
+    if (ptr_arena == nullptr && uint_capacity > 0) throw std::bad_alloc();
+}
+
+// The queued asynchronous recalls point into the networks and the arena, so they
+// are run to completion before the networks are destroyed.
+sam_pool::~sam_pool()
+{
+    workers.drain();
+    vec_networks.clear();
+    topology_free(ptr_arena, uint_capacity);
+}
+
+// The networks are bump allocated, each of them starting on a cache line. The arena
+// comes zeroed from the kernel and is never reused, so a new network is empty.
+size_t sam_pool::add(size_t nc, size_t nf)
+{
+    size_t uint_size = sam::region_size(nc, nf);
+
+    if (uint_size > uint_capacity - uint_used) throw std::bad_alloc();
+
+    vec_networks.emplace_back(new sam(nc, nf, ptr_arena + uint_used, epochs, workers));
+    uint_used += uint_size;
+
+    return vec_networks.size() - 1;
+}
+
+void sam_pool::check(const std::vector<size_t>& vec_targets) const
+{
+    for (size_t uint_query = 0; uint_query < vec_targets.size(); uint_query++)
+    {
+        if (vec_targets[uint_query] >= vec_networks.size()) throw std::invalid_argument("the query addresses no network of the pool");
+    }
+}
+
+std::vector<std::vector<std::vector<size_t>>> sam_pool::recall_blind_batch(const std::vector<size_t>& vec_targets,
+                                                                           const std::vector<std::vector<size_t>>& vec_messages,
+                                                                           const std::vector<std::vector<size_t>>& vec_clusters)
+{
+    check(vec_targets);
+
+    std::vector<std::vector<std::vector<size_t>>> vec_retrieved(vec_targets.size());
+
+    workers.parallel_for(vec_targets.size(), [&, this](size_t uint_query) {
+        vec_retrieved[uint_query] = vec_networks[vec_targets[uint_query]]->recall_blind_snapshot(vec_messages[uint_query],
+                                                                                               vec_clusters[uint_query], false);
+    });
+
+    return vec_retrieved;
+}
+
+std::vector<std::vector<std::vector<size_t>>> sam_pool::recall_guided_batch(const std::vector<size_t>& vec_targets,
+                                                                            const std::vector<std::vector<size_t>>& vec_messages,
+                                                                            const std::vector<std::vector<size_t>>& vec_clusters,
+                                                                            const std::vector<std::vector<size_t>>& vec_clusters_all,
+                                                                            size_t uint_max_it)
+{
+    check(vec_targets);
+
+    std::vector<std::vector<std::vector<size_t>>> vec_retrieved(vec_targets.size());
+
+    workers.parallel_for(vec_targets.size(), [&, this](size_t uint_query) {
+        vec_retrieved[uint_query] = vec_networks[vec_targets[uint_query]]->recall_guided_snapshot(vec_messages[uint_query],
+                                                                                                vec_clusters[uint_query],
+                                                                                                vec_clusters_all[uint_query],
+                                                                                                uint_max_it, false);
+    });
+
+    return vec_retrieved;
+}
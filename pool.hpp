@@ -0,0 +1,120 @@
+/**
+ * @file pool.hpp
+ * @brief pool of many small networks sharing one arena and one set of workers
+ *
+ * A standalone network allocates its own regions, its own epochs and starts its
+ * own threads on every recall, which dominates when many small networks are
+ * served side by side. The networks of a pool rather take their weight tensors
+ * from one contiguous arena reserved up front (backed by huge pages when possible),
+ * share the epochs of the pool and run on its workers, so that adding a network
+ * only costs its weights and its occupancy summaries.
+ */
+#ifndef __POOL_HPP__
+#define __POOL_HPP__
+
+#include <vector>
+#include <memory>
+#include <cstdlib>
+
+#include "sam.hpp"
+#include "workers.hpp"
+#include "epoch.hpp"
+
+/**
+ * @class sam_pool
+ *
+ * @brief networks of possibly different sizes hosted in one arena
+ *
+ * The networks use the dense storage and are identified by the order in which
+ * they are added. They are never removed: the arena is released with the pool.
+ * A network of the pool is used as any other network (see network), and the
+ * recalls of many networks are batched together on the shared workers.
+ *
+ * The networks share one epoch_domain, so their readers share its slots and a
+ * recall that holds its snapshot for long delays the learn calls of every network
+ * of the pool, not only its own (see epoch.hpp).
+ *
+ * The method add must not run concurrently with any other method of the pool.
+ */
+class sam_pool
+{
+
+  public:
+    /**
+     * @brief constructor
+     * @param capacity the size of the arena in bytes (see sam::region_size).
+     * @param nthreads the number of workers (the number of cores if zero).
+     *
+     * The arena is taken from reserved huge pages when the system has enough of them,
+     * in which case it is committed at once. Otherwise its pages are committed as the
+     * networks learn. It throws std::bad_alloc if the arena cannot be allocated.
+     */
+    explicit sam_pool(size_t capacity, size_t nthreads = 0);
+
+    //! destructor (releases the networks and the arena)
+    ~sam_pool();
+
+    sam_pool(const sam_pool&) = delete;
+    sam_pool& operator=(const sam_pool&) = delete;
+
+    /**
+     * @brief adds an empty network of 'nc' clusters of 'nf' fanals.
+     * @return the identifier of the network.
+     *
+     * It throws std::bad_alloc if the network does not fit in the rest of the arena.
+     */
+    size_t add(size_t nc, size_t nf);
+
+    //! the network 'id'.
+    sam& network(size_t id) { return *vec_networks[id]; }
+
+    //! the number of networks.
+    size_t size() const { return vec_networks.size(); }
+
+    //! the number of bytes of the arena taken by the networks.
+    size_t used() const { return uint_used; }
+
+    //! the size of the arena in bytes.
+    size_t capacity() const { return uint_capacity; }
+
+    /**
+     * @brief recall a batch of queries addressed to the networks of the pool by blind recall.
+     * @param vec_targets the network of each query.
+     * @param vec_messages the known sub-messages of each query.
+     * @param vec_clusters the clusters of the known sub-messages of each query.
+     * @return one retrieved message per query (see sam::recall_blind).
+     *
+     * The queries of all the networks are spread over the workers and each query is
+     * decoded by a single thread. It throws std::invalid_argument if a query addresses
+     * no network of the pool.
+     */
+    std::vector<std::vector<std::vector<size_t>>> recall_blind_batch(const std::vector<size_t>& vec_targets,
+                                                                     const std::vector<std::vector<size_t>>& vec_messages,
+                                                                     const std::vector<std::vector<size_t>>& vec_clusters);
+
+    /**
+     * @brief recall a batch of queries addressed to the networks of the pool by guided recall.
+     * @return one retrieved message per query (see sam::recall_guided).
+     */
+    std::vector<std::vector<std::vector<size_t>>> recall_guided_batch(const std::vector<size_t>& vec_targets,
+                                                                      const std::vector<std::vector<size_t>>& vec_messages,
+                                                                      const std::vector<std::vector<size_t>>& vec_clusters,
+                                                                      const std::vector<std::vector<size_t>>& vec_clusters_all,
+                                                                      size_t uint_max_it);
+
+  private:
+    // throws std::invalid_argument if a query addresses no network.
+    void check(const std::vector<size_t>& vec_targets) const;
+
+    unsigned char* ptr_arena;
+    size_t uint_capacity;
+    size_t uint_used;
+
+    // the workers and the epochs outlive the networks that use them
+    worker_pool workers;
+    epoch_domain epochs;
+
+    std::vector<std::unique_ptr<sam>> vec_networks;
+};
+
+#endif
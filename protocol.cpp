@@ -0,0 +1,43 @@
+/**
+ * @file protocol.cpp
+ * @brief binary protocol of the SAM recall daemon (sam-serve)
+ */
+
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <cerrno>
+
+#include "protocol.hpp"
+
+bool read_full(int fd, void* buffer, size_t size)
+{
+    char* ptr = (char*)buffer;
+
+    while (size > 0)
+    {
+        ssize_t ret = ::read(fd, ptr, size);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret <= 0) return false;
+        ptr  += ret;
+        size -= ret;
+    }
+
+    return true;
+}
+
+bool write_full(int fd, const void* buffer, size_t size)
+{
+    const char* ptr = (const char*)buffer;
+
+    while (size > 0)
+    {
+        ssize_t ret = ::send(fd, ptr, size, MSG_NOSIGNAL);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret <= 0) return false;
+        ptr  += ret;
+        size -= ret;
+    }
+
+    return true;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file protocol.hpp
+ * @brief binary protocol of the SAM recall daemon (sam-serve)
+ *
+ * A client sends a request header followed by its payload and receives
+ * a response header followed by its payload over a Unix domain socket.
+ * All fields are unsigned 32 bit integers in the host byte order since
+ * both ends run on the same machine.
+ *
+ * Request payloads (in this order):
+ * - SAM_OP_LEARN:          nknown message elements.
+ * - SAM_OP_RECALL_BLIND:   nknown elements, nknown clusters.
+ * - SAM_OP_RECALL_GUIDED:  nknown elements, nknown clusters, nall clusters.
+ * - SAM_OP_CONTAINS:       nknown elements, nknown clusters.
+ * - SAM_OP_STATS:          no payload.
+ * - SAM_OP_SHARD_INFO:     no payload.
+ * - SAM_OP_SHARD_LEARN:    nall message lengths, nknown elements, nknown clusters.
+ * - SAM_OP_SHARD_SCORE:    nknown active clusters, nknown active elements, nall target clusters.
+ * - SAM_OP_SHARD_RESET:    no payload.
+ *
+ * A request without a payload, or of an op the peer does not serve, may still
+ * declare nknown + nall payload entries: the peer skips them before answering.
+ * A request declaring more than SAM_MAX_ELEMENTS entries in nknown or nall is
+ * answered with SAM_STATUS_BAD_REQUEST and the connection is closed.
+ *
+ * Response payloads:
+ * - SAM_OP_LEARN:          count clusters chosen for the message elements.
+ * - SAM_OP_RECALL_*:       count elements, count clusters.
+ * - SAM_OP_CONTAINS:       no payload, the status tells the answer.
+ * - SAM_OP_STATS:          count 64 bit counters (see sam_stats_index).
+ * - SAM_OP_SHARD_INFO:     nc, nf and the range [begin, end) of the owned target clusters.
+ * - SAM_OP_SHARD_LEARN:    no payload.
+ * - SAM_OP_SHARD_SCORE:    for each owned target cluster: the cluster, its maximum activity,
+ *                          the number n of fanals with that activity and their n elements.
+ * - SAM_OP_SHARD_RESET:    no payload.
+ *
+ * The SAM_OP_SHARD_* requests are served by the shards of a sharded network
+ * (see sam_sharded) and the other requests by the recall daemon.
+ */
+#ifndef __PROTOCOL_HPP__
+#define __PROTOCOL_HPP__
+
+#include <cstdint>
+#include <cstddef>
+
+#define SAM_PROTOCOL_MAGIC  0x4d415331 // "SAM1"
+#define SAM_MAX_ELEMENTS    65536      // upper bound of nknown and nall
+#define SAM_MAX_ITERATIONS  64         // upper bound of nit (a guided recall holds up its whole batch)
+
+enum sam_op : uint32_t
+{
+    SAM_OP_LEARN            = 1,
+    SAM_OP_RECALL_BLIND     = 2,
+    SAM_OP_RECALL_GUIDED    = 3,
+    SAM_OP_CONTAINS         = 4,
+    SAM_OP_STATS            = 5,
+    SAM_OP_SHARD_INFO       = 16,
+    SAM_OP_SHARD_LEARN      = 17,
+    SAM_OP_SHARD_SCORE      = 18,
+    SAM_OP_SHARD_RESET      = 19,
+};
+
+enum sam_status : uint32_t
+{
+    SAM_STATUS_OK           = 0, // success (or the message is contained)
+    SAM_STATUS_NOT_FOUND    = 1, // ambiguous recall (or the message is not contained)
+    SAM_STATUS_BAD_REQUEST  = 2, // malformed request
+};
+
+//! indices of the counters returned by SAM_OP_STATS.
+enum sam_stats_index : uint32_t
+{
+    SAM_STATS_REQUESTS      = 0, // total number of served requests
+    SAM_STATS_BATCHES       = 1, // total number of executed micro-batches
+    SAM_STATS_LATENCY_SUM   = 2, // sum of request latencies (ns)
+    SAM_STATS_LATENCY_MAX   = 3, // maximum request latency (ns)
+    SAM_STATS_UPTIME        = 4, // time since the daemon started (ns)
+    SAM_STATS_LEARNED       = 5, // total number of learned messages
+    SAM_STATS_RECALLS       = 6, // total number of recall requests
+    SAM_STATS_COUNT         = 7,
+};
+
+struct sam_request_header
+{
+    uint32_t magic;  // SAM_PROTOCOL_MAGIC
+    uint32_t op;     // sam_op
+    uint32_t id;     // echoed back in the response
+    uint32_t nknown; // number of (known) message elements
+    uint32_t nall;   // number of message clusters (guided recall only)
+    uint32_t nit;    // number of iterations, at most SAM_MAX_ITERATIONS (guided recall only)
+};
+
+struct sam_response_header
+{
+    uint32_t magic;  // SAM_PROTOCOL_MAGIC
+    uint32_t status; // sam_status
+    uint32_t id;     // the request identifier
+    uint32_t count;  // number of payload entries
+};
+
+/**
+ * @brief reads exactly 'size' bytes unless the peer closes the connection.
+ * @return true on success.
+ */
+bool read_full(int fd, void* buffer, size_t size);
+
+/**
+ * @brief writes exactly 'size' bytes unless the peer closes the connection.
+ * @return true on success.
+ */
+bool write_full(int fd, const void* buffer, size_t size);
+
+#endif
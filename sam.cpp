@@ -13,113 +13,979 @@
  * @see https://cordis.europa.eu/project/rcn/102141_en.html 
  */
 
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <mutex>
+#include <numeric>
+#include <limits>
+
 #include "sam.hpp"
 
-sam::sam(size_t nc, size_t nf)
+sam::sam(size_t nc, size_t nf, storage backend) : sam(nc, nf, 0, nc, backend)
+{
+}
+
+sam::sam(size_t nc, size_t nf, size_t cluster_begin, size_t cluster_end, storage backend)
+    : numa_local(0), numa_remote(0), own_epochs(new epoch_domain()), epochs(*own_epochs), ptr_workers(nullptr),
+      storage_backend(backend)
+{
+	nclusters = nc;
+	nfanals   = nf;
+
+    this->cluster_begin = std::min(cluster_begin, nclusters);
+    this->cluster_end   = std::max(std::min(cluster_end, nclusters), this->cluster_begin);
+
+    size_t uint_num_rows  = this->cluster_end - this->cluster_begin;
+    size_t uint_num_nodes = std::min(topology_nodes(), std::max(uint_num_rows, (size_t)1));
+
+    // The rows are split over the NUMA nodes in contiguous ranges of target clusters.
+    vec_nodes = std::vector<size_t>(uint_num_rows, 0);
+
+    for (size_t uint_row = 0; uint_row < uint_num_rows; uint_row++)
+    {
+        vec_nodes[uint_row] = uint_row * uint_num_nodes / uint_num_rows;
+    }
+
+    ncores = std::thread::hardware_concurrency();
+
+    if (storage_backend == storage_blocks)
+    {
+        // the keys of a block must fit in 32 bits.
+        if (nfanals > 0xffff) throw std::invalid_argument("the block storage requires less than 65536 fanals");
+
+        vec_blocks = std::vector<block>(uint_num_rows * nclusters);
+        pthread_rwlock_init(&rwl_blocks, nullptr);
+        return;
+    }
+
+    vec_weights         = std::vector<unsigned char*>(uint_num_rows, nullptr);
+    vec_occupied_blocks = std::vector<uint64_t>(uint_num_rows * words(nclusters), 0);
+    vec_occupied_fanals = std::vector<uint64_t>(uint_num_rows * nclusters * words(nfanals), 0);
+
+    // The rows of a node share one region (backed by huge pages if large enough), each
+    // of them starting on a cache line.
+    vec_regions      = std::vector<unsigned char*>(uint_num_nodes, nullptr);
+    vec_region_sizes = std::vector<size_t>(uint_num_nodes, 0);
+
+    for (size_t uint_row = 0; uint_row < uint_num_rows; uint_row++)
+    {
+        vec_region_sizes[vec_nodes[uint_row]] += row_stride();
+    }
+
+    for (size_t uint_node = 0; uint_node < uint_num_nodes; uint_node++)
+    {
+        vec_regions[uint_node] = (unsigned char*)topology_alloc(vec_region_sizes[uint_node], uint_node);
+
+        if (vec_regions[uint_node] == nullptr && vec_region_sizes[uint_node] > 0)
+        {
+            for (size_t uint_indx = 0; uint_indx < uint_node; uint_indx++) topology_free(vec_regions[uint_indx], vec_region_sizes[uint_indx]);
+            throw std::bad_alloc();
+        }
+    }
+
+    for (size_t uint_row = 0, uint_offset = 0; uint_row < uint_num_rows; uint_row++)
+    {
+        // the rows of a node are contiguous.
+        if (uint_row > 0 && vec_nodes[uint_row] != vec_nodes[uint_row - 1]) uint_offset = 0;
+
+        vec_weights[uint_row] = vec_regions[vec_nodes[uint_row]] + uint_offset;
+        uint_offset += row_stride();
+    }
+}
+
+// The rows of a hosted network are contiguous in the memory given by the pool, which also
+// frees it, so that the network itself only allocates its occupancy summaries.
+sam::sam(size_t nc, size_t nf, unsigned char* ptr_weights, epoch_domain& domain, worker_pool& workers)
+    : numa_local(0), numa_remote(0), epochs(domain), ptr_workers(&workers), storage_backend(storage_dense)
+{
+    nclusters     = nc;
+    nfanals       = nf;
+    cluster_begin = 0;
+    cluster_end   = nc;
+    ncores        = workers.size();
+
+    vec_nodes           = std::vector<size_t>(nclusters, 0);
+    vec_weights         = std::vector<unsigned char*>(nclusters, nullptr);
+    vec_occupied_blocks = std::vector<uint64_t>(nclusters * words(nclusters), 0);
+    vec_occupied_fanals = std::vector<uint64_t>(nclusters * nclusters * words(nfanals), 0);
+
+    for (size_t uint_row = 0; uint_row < nclusters; uint_row++)
+    {
+        vec_weights[uint_row] = ptr_weights + uint_row * row_stride();
+    }
+}
+
+size_t sam::region_size(size_t nc, size_t nf)
+{
+    return nc * ((nc * nf * nf + TOPOLOGY_ALIGNMENT - 1) / TOPOLOGY_ALIGNMENT * TOPOLOGY_ALIGNMENT);
+}
+
+sam::~sam()
+{
+    for (size_t uint_node = 0; uint_node < vec_regions.size(); uint_node++)
+    {
+        topology_free(vec_regions[uint_node], vec_region_sizes[uint_node]);
+    }
+
+    if (storage_backend == storage_blocks) pthread_rwlock_destroy(&rwl_blocks);
+}
+
+void sam::reset()
+{
+    for (size_t uint_row = 0; uint_row < vec_weights.size(); uint_row++)
+    {
+        std::memset(vec_weights[uint_row], 0, row_size());
+    }
+
+    for (size_t uint_block = 0; uint_block < vec_blocks.size(); uint_block++)
+    {
+        vec_blocks[uint_block].reset();
+    }
+
+    std::fill(vec_occupied_blocks.begin(), vec_occupied_blocks.end(), 0);
+    std::fill(vec_occupied_fanals.begin(), vec_occupied_fanals.end(), 0);
+
+    forget_epochs();
+}
+
+// The epochs of a pool are shared by its networks, so only the logged connections
+// of this network are dropped.
+void sam::forget_epochs()
+{
+    if (own_epochs)
+        epochs.clear();
+    else if (!vec_weights.empty())
+        epochs.forget(vec_weights.front(), vec_weights.size() * row_stride());
+}
+
+void sam::summarize()
+{
+    std::fill(vec_occupied_blocks.begin(), vec_occupied_blocks.end(), 0);
+    std::fill(vec_occupied_fanals.begin(), vec_occupied_fanals.end(), 0);
+
+    for (size_t uint_cluster = cluster_begin; uint_cluster < cluster_end; uint_cluster++)
+    {
+        for (size_t uint_cluster_ = 0; uint_cluster_ < nclusters; uint_cluster_++)
+        {
+            for (size_t uint_fanal = 0; uint_fanal < nfanals; uint_fanal++)
+            {
+                for (size_t uint_fanal_ = 0; uint_fanal_ < nfanals; uint_fanal_++)
+                {
+                    if (weight(uint_cluster, uint_cluster_, uint_fanal, uint_fanal_) != 0) occupy(uint_cluster, uint_cluster_, uint_fanal_);
+                }
+            }
+        }
+    }
+}
+
+size_t sam::bytes() const
+{
+    storage_lock lock(*this, false);
+
+    size_t uint_bytes = vec_weights.size() * row_size() + vec_blocks.size() * sizeof(block) +
+                        (vec_occupied_blocks.size() + vec_occupied_fanals.size()) * sizeof(uint64_t);
+
+    for (size_t uint_block = 0; uint_block < vec_blocks.size(); uint_block++)
+    {
+        uint_bytes += vec_blocks[uint_block].bytes();
+    }
+
+    return uint_bytes;
+}
+
+// The block storage has no snapshots: the readers share the lock while a learn call holds it alone.
+sam::storage_lock::storage_lock(const sam& memory, bool bool_write) : memory(memory)
+{
+    if (memory.storage_backend != storage_blocks) return;
+
+    if (bool_write)
+        pthread_rwlock_wrlock(&memory.rwl_blocks);
+    else
+        pthread_rwlock_rdlock(&memory.rwl_blocks);
+}
+
+sam::storage_lock::~storage_lock()
+{
+    if (memory.storage_backend == storage_blocks) pthread_rwlock_unlock(&memory.rwl_blocks);
+}
+
+sam::numa_counters sam::numa() const
+{
+    numa_counters counters;
+
+    counters.nodes  = vec_nodes.empty() ? 1 : vec_nodes.back() + 1;
+    counters.local  = numa_local;
+    counters.remote = numa_remote;
+
+    return counters;
+}
+
+// The binary network file starts with a header holding a magic number, the file
+// format version and the network parameters. The connections follow as one byte
+// per connection in the order of the weight tensor dimensions.
+static const char     SAM_FILE_MAGIC[4] = {'S', 'A', 'M', 'W'};
+static const uint32_t SAM_FILE_VERSION  = 1;
+
+// The number of messages a learn call publishes at once.
+#define SAM_MESSAGES_PER_EPOCH 4096
+
+bool sam::probe(const char* filename, size_t& nc, size_t& nf)
+{
+    std::ifstream fs_network(filename, std::ios::in | std::ios::binary);
+    if (!fs_network) return false;
+
+    char     magic[4];
+    uint32_t version;
+    uint64_t header[2];
+
+    fs_network.read(magic, sizeof(magic));
+    fs_network.read((char*)&version, sizeof(version));
+    fs_network.read((char*)header, sizeof(header));
+
+    if (!fs_network || std::memcmp(magic, SAM_FILE_MAGIC, sizeof(magic)) != 0 || version != SAM_FILE_VERSION)
+        return false;
+
+    nc = header[0];
+    nf = header[1];
+
+    return true;
+}
+
+bool sam::save(const char* filename) const
+{
+    if (cluster_begin != 0 || cluster_end != nclusters || storage_backend != storage_dense) return false;
+
+    std::ofstream fs_network(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!fs_network) return false;
+
+    uint64_t header[2] = {nclusters, nfanals};
+
+    fs_network.write(SAM_FILE_MAGIC, sizeof(SAM_FILE_MAGIC));
+    fs_network.write((const char*)&SAM_FILE_VERSION, sizeof(SAM_FILE_VERSION));
+    fs_network.write((const char*)header, sizeof(header));
+
+    // The connections of a snapshot are written, which keeps the file consistent
+    // even if messages are being learned.
+    epoch_guard guard(epochs);
+    std::vector<char> vec_row(row_size());
+
+    for (size_t uint_row = 0; uint_row < vec_weights.size(); uint_row++)
+    {
+        for (size_t uint_indx = 0; uint_indx < row_size(); uint_indx++)
+        {
+            vec_row[uint_indx] = epoch_domain::visible(__atomic_load_n(&vec_weights[uint_row][uint_indx], __ATOMIC_RELAXED), guard.epoch());
+        }
+
+        fs_network.write(vec_row.data(), row_size());
+    }
+
+    return (bool)fs_network;
+}
+
+bool sam::load(const char* filename)
+{
+    size_t nc, nf;
+    if (storage_backend != storage_dense || !probe(filename, nc, nf) || nc != nclusters || nf != nfanals) return false;
+
+    std::ifstream fs_network(filename, std::ios::in | std::ios::binary);
+    fs_network.seekg(sizeof(SAM_FILE_MAGIC) + sizeof(SAM_FILE_VERSION) + 2 * sizeof(uint64_t) +
+                     cluster_begin * nclusters * nfanals * nfanals);
+
+    for (size_t uint_row = 0; uint_row < vec_weights.size(); uint_row++)
+    {
+        fs_network.read((char*)vec_weights[uint_row], row_size());
+    }
+
+    forget_epochs();
+
+    if (!fs_network)
+    {
+        reset();
+        return false;
+    }
+
+    summarize();
+
+    return true;
+}
+
+// A message is considered to be learned if its clique exists in the network,
+// i.e. all the pairs of its elements are connected. A shard only checks the
+// connections towards the clusters it owns.
+bool sam::contains(const std::vector<size_t>& vec_message, const std::vector<size_t>& vec_clusters) const
+{
+    size_t uint_num_msg_clusters = vec_message.size();
+
+    if (uint_num_msg_clusters != vec_clusters.size()) return false;
+
+    if (storage_backend == storage_blocks)
+    {
+        storage_lock lock(*this, false);
+
+        for (size_t uint_cluster = 0; uint_cluster < uint_num_msg_clusters; uint_cluster++)
+        {
+            for (size_t uint_cluster_ = 0; uint_cluster_ < uint_num_msg_clusters; uint_cluster_++)
+            {
+                if (uint_cluster != uint_cluster_ &&
+                    vec_clusters[uint_cluster] >= cluster_begin && vec_clusters[uint_cluster] < cluster_end &&
+                    !connections(vec_clusters[uint_cluster], vec_clusters[uint_cluster_]).test(key(vec_message[uint_cluster] - 1,
+                                                                                                     vec_message[uint_cluster_] - 1)))
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    epoch_guard guard(epochs);
+
+    for (size_t uint_cluster = 0; uint_cluster < uint_num_msg_clusters; uint_cluster++)
+    {
+        for (size_t uint_cluster_ = 0; uint_cluster_ < uint_num_msg_clusters; uint_cluster_++)
+        {
+            if (uint_cluster != uint_cluster_ &&
+                vec_clusters[uint_cluster] >= cluster_begin && vec_clusters[uint_cluster] < cluster_end &&
+                !epoch_domain::visible(__atomic_load_n(&weight(vec_clusters[uint_cluster],
+                                                               vec_clusters[uint_cluster_],
+                                                               vec_message[uint_cluster] - 1,
+                                                               vec_message[uint_cluster_] - 1), __ATOMIC_RELAXED),
+                                       guard.epoch()))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// This routine learns the two dimensional set of
+// messages given by 'vec_message'
+std::vector<std::vector<size_t>> sam::learn(const std::vector<std::vector<size_t>>& vec_message)
+{
+    // In the manuscript it is assumed that the exploited clusters
+    // for each clique are chosen uniformly random.
+    std::vector<std::vector<size_t>> vec_random_clusters = random_clusters(vec_message, nclusters);
+
+    learn(vec_message, vec_random_clusters);
+
+    return vec_random_clusters;
+}
+
+// The messages given as nested vectors, with the accessors of a message file (see dataset).
+struct nested_messages
+{
+    nested_messages(const std::vector<std::vector<size_t>>& vec_message, const std::vector<std::vector<size_t>>& vec_clusters)
+        : vec_message(vec_message), vec_clusters(vec_clusters) {}
+
+    size_t size() const { return vec_message.size(); }
+    size_t length(size_t i) const { return vec_message[i].size(); }
+    size_t element(size_t i, size_t j) const { return vec_message[i][j]; }
+    size_t cluster(size_t i, size_t j) const { return vec_clusters[i][j]; }
+
+    const std::vector<std::vector<size_t>>& vec_message;
+    const std::vector<std::vector<size_t>>& vec_clusters;
+};
+
+void sam::learn(const std::vector<std::vector<size_t>>& vec_message, const std::vector<std::vector<size_t>>& vec_clusters)
+{
+    learn_messages(nested_messages(vec_message, vec_clusters));
+}
+
+void sam::learn(const dataset& data)
+{
+    if (data.fanals() > nfanals || data.clusters() > nclusters)
+        throw std::invalid_argument("the messages do not fit in the network");
+
+    learn_messages(data);
+}
+
+// This routine learns the input messages in cliques
+// by construing the connections in the way that is elaborated in
+// the manuscript.
+template <typename messages_t> void sam::learn_messages(const messages_t& messages)
+{
+    if (storage_backend == storage_blocks)
+    {
+        learn_blocks(messages);
+        return;
+    }
+
+    size_t uint_num_messages                = messages.size();
+    size_t uint_num_msg_clusters            = 0;
+
+    // The messages are published in chunks, each of them in its own epoch.
+    for (size_t uint_chunk = 0; uint_chunk < uint_num_messages; uint_chunk += SAM_MESSAGES_PER_EPOCH)
+    {
+        epoch_writer writer(epochs);
+
+        for (size_t uint_msg_indx = uint_chunk; uint_msg_indx < std::min(uint_chunk + SAM_MESSAGES_PER_EPOCH, uint_num_messages); uint_msg_indx++)
+        {
+            uint_num_msg_clusters = messages.length(uint_msg_indx);
+            for (size_t uint_cluster = 0; uint_cluster < uint_num_msg_clusters; uint_cluster++)
+            {
+                size_t uint_target = messages.cluster(uint_msg_indx, uint_cluster);
+
+                // a shard only stores the connections towards the clusters it owns.
+                if (uint_target < cluster_begin || uint_target >= cluster_end) continue;
+
+                for (size_t uint_cluster_ = 0; uint_cluster_ < uint_num_msg_clusters; uint_cluster_++)
+                {
+                    if (uint_cluster == uint_cluster_) continue;
+
+                    occupy(uint_target,
+                           messages.cluster(uint_msg_indx, uint_cluster_),
+                           messages.element(uint_msg_indx, uint_cluster_) - 1);
+
+                    writer.set(&weight(uint_target,
+                                       messages.cluster(uint_msg_indx, uint_cluster_),
+                                       messages.element(uint_msg_indx, uint_cluster) - 1,
+                                       messages.element(uint_msg_indx, uint_cluster_) - 1));
+                }
+            }
+        }
+
+        writer.commit();
+    }
+}
+
+// The block storage learns the messages in chunks: the connections of a chunk are
+// collected as (block, key) pairs and sorted, so each block merges its new keys at once.
+template <typename messages_t> void sam::learn_blocks(const messages_t& messages)
+{
+    size_t uint_num_messages = messages.size();
+    uint64_t uint_universe   = (uint64_t)nfanals * nfanals;
+
+    std::vector<uint64_t> vec_pairs;
+    std::vector<uint32_t> vec_keys;
+
+    for (size_t uint_chunk = 0; uint_chunk < uint_num_messages; uint_chunk += SAM_MESSAGES_PER_EPOCH)
+    {
+        vec_pairs.clear();
+
+        for (size_t uint_msg_indx = uint_chunk; uint_msg_indx < std::min(uint_chunk + SAM_MESSAGES_PER_EPOCH, uint_num_messages); uint_msg_indx++)
+        {
+            size_t uint_num_msg_clusters = messages.length(uint_msg_indx);
+            for (size_t uint_cluster = 0; uint_cluster < uint_num_msg_clusters; uint_cluster++)
+            {
+                size_t uint_target = messages.cluster(uint_msg_indx, uint_cluster);
+
+                // a shard only stores the connections towards the clusters it owns.
+                if (uint_target < cluster_begin || uint_target >= cluster_end) continue;
+
+                for (size_t uint_cluster_ = 0; uint_cluster_ < uint_num_msg_clusters; uint_cluster_++)
+                {
+                    if (uint_cluster != uint_cluster_)
+                        vec_pairs.push_back((uint64_t)((uint_target - cluster_begin) * nclusters + messages.cluster(uint_msg_indx, uint_cluster_)) << 32 |
+                                            key(messages.element(uint_msg_indx, uint_cluster) - 1, messages.element(uint_msg_indx, uint_cluster_) - 1));
+                }
+            }
+        }
+
+        std::sort(vec_pairs.begin(), vec_pairs.end());
+        vec_pairs.erase(std::unique(vec_pairs.begin(), vec_pairs.end()), vec_pairs.end());
+
+        storage_lock lock(*this, true);
+
+        for (std::vector<uint64_t>::const_iterator itp = vec_pairs.begin(); itp != vec_pairs.end();)
+        {
+            uint64_t uint_block = *itp >> 32;
+
+            vec_keys.clear();
+            for (; itp != vec_pairs.end() && (*itp >> 32) == uint_block; itp++) vec_keys.push_back((uint32_t)*itp);
+
+            vec_blocks[uint_block].insert(vec_keys, uint_universe);
+        }
+    }
+}
+
+// This routine computes the overall scores of the fanals in the cluster 'uint_cluster'
+// that are connected to the active fanals listed in 'vec_network_list' for the
+// active clusters given in 'vec_clusters_lag'. It returns whether the row has been scanned.
+bool sam::score_cluster(size_t uint_cluster,
+                        const scratch_vector& vec_clusters_lag,
+                        const scratch_matrix& vec_network_list,
+                        scratch_vector& vec_scores,
+                        uint64_t uint_epoch) const
+{
+    if (storage_backend == storage_blocks)
+    {
+        score_cluster_blocks(uint_cluster, vec_clusters_lag, vec_network_list, vec_scores);
+        return false;
+    }
+
+    const unsigned char* ptr_row = vec_weights[uint_cluster - cluster_begin];
+
+    // The occupancy summaries drop the active clusters whose block is empty and the active
+    // fanals with no connection towards the cluster. The remaining fanals are kept as the
+    // offsets of their connections from the first target fanal, grouped by cluster.
+    static thread_local std::vector<size_t> vec_offsets;
+    static thread_local std::vector<size_t> vec_groups;
+
+    vec_offsets.clear();
+    vec_groups.clear();
+
+    for (scratch_vector::const_iterator itc = vec_clusters_lag.begin(); itc != vec_clusters_lag.end(); itc++)
+    {
+        if (!occupied(uint_cluster, *itc)) continue;
+
+        for (scratch_vector::const_iterator itf = vec_network_list[*itc].begin(); itf != vec_network_list[*itc].end(); itf++)
+        {
+            if (occupied(uint_cluster, *itc, *itf - 1)) vec_offsets.push_back(*itc * nfanals * nfanals + *itf - 1);
+        }
+
+        if (vec_offsets.size() > (vec_groups.empty() ? 0 : vec_groups.back())) vec_groups.push_back(vec_offsets.size());
+    }
+
+    // no active fanal is connected to the cluster.
+    if (vec_groups.empty()) return false;
+
+    for (size_t uint_fanal = 0; uint_fanal < nfanals; uint_fanal++)
+    {
+        size_t uint_first = 0;
+
+        for (std::vector<size_t>::const_iterator itg = vec_groups.begin(); itg != vec_groups.end(); uint_first = *itg++)
+        {
+            for (size_t uint_indx = uint_first; uint_indx < *itg; uint_indx++)
+            {
+                if (epoch_domain::visible(__atomic_load_n(&ptr_row[vec_offsets[uint_indx] + uint_fanal * nfanals], __ATOMIC_RELAXED), uint_epoch))
+                {
+                    vec_scores[uint_fanal]++;
+                    // 'break' is to assure a fanal receives only one signal unit from a cluster
+                    // (that may have more than one active fanal)
+                    break;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// The block storage walks the connections of each active source fanal rather than testing
+// every (target fanal, source fanal) pair, so the cost follows the number of connections.
+// A target fanal is stamped with the source cluster that last signaled it to receive only
+// one signal unit per cluster.
+void sam::score_cluster_blocks(size_t uint_cluster,
+                               const scratch_vector& vec_clusters_lag,
+                               const scratch_matrix& vec_network_list,
+                               scratch_vector& vec_scores) const
+{
+    static thread_local std::vector<size_t> vec_stamps;
+    vec_stamps.assign(nfanals, 0);
+
+    size_t uint_stamp = 0;
+
+    for (scratch_vector::const_iterator itc = vec_clusters_lag.begin(); itc != vec_clusters_lag.end(); itc++)
+    {
+        const block& blk = connections(uint_cluster, *itc);
+
+        uint_stamp++;
+        if (blk.empty()) continue;
+
+        for (scratch_vector::const_iterator itf = vec_network_list[*itc].begin(); itf != vec_network_list[*itc].end(); itf++)
+        {
+            blk.for_each(key(0, *itf - 1), key(0, *itf), [&](uint32_t uint_fanal) {
+                if (vec_stamps[uint_fanal] != uint_stamp)
+                {
+                    vec_stamps[uint_fanal] = uint_stamp;
+                    vec_scores[uint_fanal]++;
+                }
+            });
+        }
+    }
+}
+
+// This routine performs the blind recovery. The input parameters are the known sub-messages
+// given in 'vec_message' and their corresponding clusters given in 'vec_clusters'.
+// The default number of iterations in this recovery mode is set to one since it does not help
+// the error rate performance.
+std::vector<std::vector<size_t>> sam::recall_blind(const std::vector<size_t>& vec_message, const std::vector<size_t>& vec_clusters)
+{
+    return recall_blind_snapshot(vec_message, vec_clusters, true);
+}
+
+std::vector<std::vector<size_t>> sam::recall_guided(const std::vector<size_t>& vec_message,
+                                                    const std::vector<size_t>& vec_clusters,
+                                                    const std::vector<size_t>& vec_clusters_all,
+                                                    size_t uint_max_it)
+{
+    return recall_guided_snapshot(vec_message, vec_clusters, vec_clusters_all, uint_max_it, true);
+}
+
+// The decoder writes the retrieved message into the slots, without building it first.
+bool sam::recall_blind(const std::vector<size_t>& vec_message,
+                       const std::vector<size_t>& vec_clusters,
+                       const cluster_slots& slots,
+                       size_t* ptr_retrieved)
+{
+    using namespace std::placeholders;
+
+    epoch_guard guard(epochs);
+    storage_lock lock(*this, false);
+
+    return decode_blind(nclusters, nfanals, vec_message, vec_clusters,
+                        std::bind(&sam::score_snapshot, this, _1, _2, _3, _4, true, guard.epoch()), slots, ptr_retrieved);
+}
+
+bool sam::recall_guided(const std::vector<size_t>& vec_message,
+                        const std::vector<size_t>& vec_clusters,
+                        const std::vector<size_t>& vec_clusters_all,
+                        size_t uint_max_it,
+                        const cluster_slots& slots,
+                        size_t* ptr_retrieved)
+{
+    using namespace std::placeholders;
+
+    epoch_guard guard(epochs);
+    storage_lock lock(*this, false);
+
+    return decode_guided(nclusters, nfanals, vec_message, vec_clusters, vec_clusters_all, uint_max_it,
+                         std::bind(&sam::score_snapshot, this, _1, _2, _3, _4, true, guard.epoch()), slots, ptr_retrieved);
+}
+
+std::vector<std::vector<size_t>> sam::recall_blind_snapshot(const std::vector<size_t>& vec_message,
+                                                            const std::vector<size_t>& vec_clusters,
+                                                            bool bool_threads) const
+{
+    using namespace std::placeholders;
+
+    epoch_guard guard(epochs);
+    storage_lock lock(*this, false);
+
+    return decode_blind(nclusters, nfanals, vec_message, vec_clusters,
+                        std::bind(&sam::score_snapshot, this, _1, _2, _3, _4, bool_threads, guard.epoch()));
+}
+
+std::vector<std::vector<size_t>> sam::recall_guided_snapshot(const std::vector<size_t>& vec_message,
+                                                             const std::vector<size_t>& vec_clusters,
+                                                             const std::vector<size_t>& vec_clusters_all,
+                                                             size_t uint_max_it,
+                                                             bool bool_threads) const
+{
+    using namespace std::placeholders;
+
+    epoch_guard guard(epochs);
+    storage_lock lock(*this, false);
+
+    return decode_guided(nclusters, nfanals, vec_message, vec_clusters, vec_clusters_all, uint_max_it,
+                         std::bind(&sam::score_snapshot, this, _1, _2, _3, _4, bool_threads, guard.epoch()));
+}
+
+// An asynchronous recall copies its query into a task of the workers, which decodes it
+// within a single thread in a snapshot taken when the task starts.
+void sam::recall_blind_async(const std::vector<size_t>& vec_message,
+                             const std::vector<size_t>& vec_clusters,
+                             recall_callback done) const
+{
+    if (!done) throw std::invalid_argument("no completion callback");
+
+    async_workers().submit([this, vec_message, vec_clusters, done]() {
+        std::vector<std::vector<size_t>> vec_retrieved;
+        std::exception_ptr error;
+
+        try
+        {
+            vec_retrieved = recall_blind_snapshot(vec_message, vec_clusters, false);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        done(std::move(vec_retrieved), error);
+    });
+}
+
+void sam::recall_guided_async(const std::vector<size_t>& vec_message,
+                              const std::vector<size_t>& vec_clusters,
+                              const std::vector<size_t>& vec_clusters_all,
+                              size_t uint_max_it,
+                              recall_callback done) const
+{
+    if (!done) throw std::invalid_argument("no completion callback");
+
+    async_workers().submit([this, vec_message, vec_clusters, vec_clusters_all, uint_max_it, done]() {
+        std::vector<std::vector<size_t>> vec_retrieved;
+        std::exception_ptr error;
+
+        try
+        {
+            vec_retrieved = recall_guided_snapshot(vec_message, vec_clusters, vec_clusters_all, uint_max_it, false);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        done(std::move(vec_retrieved), error);
+    });
+}
+
+// The future is fulfilled by the completion callback.
+static sam::recall_callback fulfill(const std::shared_ptr<std::promise<std::vector<std::vector<size_t>>>>& promise)
+{
+    return [promise](std::vector<std::vector<size_t>>&& vec_retrieved, std::exception_ptr error) {
+        if (error)
+            promise->set_exception(error);
+        else
+            promise->set_value(std::move(vec_retrieved));
+    };
+}
+
+std::future<std::vector<std::vector<size_t>>> sam::recall_blind_async(const std::vector<size_t>& vec_message,
+                                                                      const std::vector<size_t>& vec_clusters) const
+{
+    std::shared_ptr<std::promise<std::vector<std::vector<size_t>>>> promise = std::make_shared<std::promise<std::vector<std::vector<size_t>>>>();
+    std::future<std::vector<std::vector<size_t>>> future = promise->get_future();
+
+    recall_blind_async(vec_message, vec_clusters, fulfill(promise));
+
+    return future;
+}
+
+std::future<std::vector<std::vector<size_t>>> sam::recall_guided_async(const std::vector<size_t>& vec_message,
+                                                                       const std::vector<size_t>& vec_clusters,
+                                                                       const std::vector<size_t>& vec_clusters_all,
+                                                                       size_t uint_max_it) const
+{
+    std::shared_ptr<std::promise<std::vector<std::vector<size_t>>>> promise = std::make_shared<std::promise<std::vector<std::vector<size_t>>>>();
+    std::future<std::vector<std::vector<size_t>>> future = promise->get_future();
+
+    recall_guided_async(vec_message, vec_clusters, vec_clusters_all, uint_max_it, fulfill(promise));
+
+    return future;
+}
+
+// The batch routines spread the queries over the cores, one worker per core taking every
+// 'uint_num_workers'-th query, and decode each query within a single thread. This avoids
+// spawning one thread per cluster for every query which dominates the recall time for
+// small networks. The networks of a pool run the queries on its workers instead.
+void sam::parallel_for(size_t uint_num_queries, const std::function<void(size_t)>& query_fn) const
+{
+    if (ptr_workers != nullptr)
+    {
+        ptr_workers->parallel_for(uint_num_queries, query_fn);
+        return;
+    }
+
+    size_t uint_num_workers = std::min(std::max(ncores, (size_t)1), uint_num_queries);
+
+    std::vector<std::thread> workers(uint_num_workers);
+
+    // the first exception of a worker is thrown again by the calling thread.
+    std::exception_ptr error;
+    std::mutex mtx_error;
+
+    for (size_t uint_worker = 0; uint_worker < uint_num_workers; uint_worker++)
+    {
+        workers[uint_worker] = std::thread([&, uint_worker]() {
+            try
+            {
+                for (size_t uint_query = uint_worker; uint_query < uint_num_queries; uint_query += uint_num_workers)
+                {
+                    query_fn(uint_query);
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mtx_error);
+                if (!error) error = std::current_exception();
+            }
+        });
+    }
+
+    std::for_each(workers.begin(), workers.end(), std::mem_fn(&std::thread::join));
+
+    if (error) std::rethrow_exception(error);
+}
+
+std::vector<std::vector<std::vector<size_t>>> sam::recall_blind_batch(const std::vector<std::vector<size_t>>& vec_messages,
+                                                                      const std::vector<std::vector<size_t>>& vec_clusters)
 {
-	nclusters = nc;
-	nfanals   = nf;
+    std::vector<std::vector<std::vector<size_t>>> vec_retrieved(vec_messages.size());
 
-    vec_weights = std::vector < std::vector < std::vector < std::vector <char> > > > (nclusters, 
-                    std::vector < std::vector < std::vector <char> > > (nclusters,
-                    std::vector < std::vector <char> > (nfanals,
-                    std::vector <char> (nfanals,0))));
+    parallel_for(vec_messages.size(), [&, this](size_t uint_query) {
+        vec_retrieved[uint_query] = recall_blind_snapshot(vec_messages[uint_query], vec_clusters[uint_query], false);
+    });
 
-    ncores = std::thread::hardware_concurrency();
+    return vec_retrieved;
 }
 
-sam::~sam()
+std::vector<std::vector<std::vector<size_t>>> sam::recall_guided_batch(const std::vector<std::vector<size_t>>& vec_messages,
+                                                                       const std::vector<std::vector<size_t>>& vec_clusters,
+                                                                       const std::vector<std::vector<size_t>>& vec_clusters_all,
+                                                                       size_t uint_max_it)
 {
+    std::vector<std::vector<std::vector<size_t>>> vec_retrieved(vec_messages.size());
+
+    parallel_for(vec_messages.size(), [&, this](size_t uint_query) {
+        vec_retrieved[uint_query] = recall_guided_snapshot(vec_messages[uint_query], vec_clusters[uint_query],
+                                                           vec_clusters_all[uint_query], uint_max_it, false);
+    });
+
+    return vec_retrieved;
 }
 
-void sam::reset()
+// The queries of a message file are its messages whose last elements are erased. Only the
+// few elements of a query are copied into the vectors the decoders take.
+static void file_query(const dataset& data, size_t uint_query, size_t uint_num_erased,
+                       std::vector<size_t>& vec_message, std::vector<size_t>& vec_clusters, std::vector<size_t>& vec_clusters_all)
 {
-    for (size_t uint_cluster_i = 0; uint_cluster_i < nclusters; uint_cluster_i++)
+    size_t uint_length    = data.length(uint_query);
+    size_t uint_num_known = uint_length - std::min(uint_num_erased, uint_length);
+
+    vec_message.resize(uint_num_known);
+    vec_clusters.resize(uint_num_known);
+    vec_clusters_all.resize(uint_length);
+
+    for (size_t uint_cluster = 0; uint_cluster < uint_length; uint_cluster++)
     {
-        for (size_t uint_cluster_j = 0; uint_cluster_j < nclusters; uint_cluster_j++)
+        vec_clusters_all[uint_cluster] = data.cluster(uint_query, uint_cluster);
+
+        if (uint_cluster < uint_num_known)
         {
-            for (size_t uint_fanal_i = 0; uint_fanal_i < nfanals; uint_fanal_i++)
-            {
-                for (size_t uint_fanal_j = 0; uint_fanal_j < nfanals; uint_fanal_j++)
-                {
-                    vec_weights[uint_cluster_i][uint_cluster_j][uint_fanal_i][uint_fanal_j] = 0;
-                }
-            }
+            vec_message[uint_cluster]  = data.element(uint_query, uint_cluster);
+            vec_clusters[uint_cluster] = vec_clusters_all[uint_cluster];
         }
     }
 }
 
-// This routine learns the two dimensional set of
-// messages given by 'vec_message'
-std::vector<std::vector<size_t>> sam::learn(const std::vector<std::vector<size_t>>& vec_message)
+std::vector<std::vector<std::vector<size_t>>> sam::recall_blind_batch(const dataset& data, size_t uint_num_erased)
 {
-    size_t uint_num_messages                = vec_message.size();
-    size_t uint_cumulative_message_length   = 0;
-    size_t uint_num_msg_clusters            = 0;
-    size_t uint_random_cluster_counter      = 0;
-    size_t uint_randint                     = 0;
+    if (data.fanals() > nfanals || data.clusters() > nclusters)
+        throw std::invalid_argument("the messages do not fit in the network");
 
-    // This part choose random cluster to learn the messages.
-    // In the manuscript it is assumed that the exploited clusters
-    // for each clique are chosen uniformly random.
-    std::vector<std::vector<size_t>> vec_random_clusters(uint_num_messages, std::vector<size_t>(0));
-    for (size_t uint_msg_indx = 0; uint_msg_indx < uint_num_messages; uint_msg_indx++)
+    std::vector<std::vector<std::vector<size_t>>> vec_retrieved(data.size());
+
+    parallel_for(data.size(), [&, this](size_t uint_query) {
+        std::vector<size_t> vec_message, vec_clusters, vec_clusters_all;
+        file_query(data, uint_query, uint_num_erased, vec_message, vec_clusters, vec_clusters_all);
+
+        vec_retrieved[uint_query] = recall_blind_snapshot(vec_message, vec_clusters, false);
+    });
+
+    return vec_retrieved;
+}
+
+std::vector<std::vector<std::vector<size_t>>> sam::recall_guided_batch(const dataset& data, size_t uint_num_erased, size_t uint_max_it)
+{
+    if (data.fanals() > nfanals || data.clusters() > nclusters)
+        throw std::invalid_argument("the messages do not fit in the network");
+
+    std::vector<std::vector<std::vector<size_t>>> vec_retrieved(data.size());
+
+    parallel_for(data.size(), [&, this](size_t uint_query) {
+        std::vector<size_t> vec_message, vec_clusters, vec_clusters_all;
+        file_query(data, uint_query, uint_num_erased, vec_message, vec_clusters, vec_clusters_all);
+
+        vec_retrieved[uint_query] = recall_guided_snapshot(vec_message, vec_clusters, vec_clusters_all, uint_max_it, false);
+    });
+
+    return vec_retrieved;
+}
+
+// The scores of the target clusters are computed by the given scoring step so that
+// the same decoder runs on a local network, in a single thread or in many threads,
+// and on a network whose target clusters are spread over shards.
+void sam::score(const std::vector<size_t>& vec_targets,
+                const scratch_vector& vec_clusters_lag,
+                const scratch_matrix& vec_network_list,
+                scratch_matrix& vec_network,
+                bool bool_threads) const
+{
+    epoch_guard guard(epochs);
+    storage_lock lock(*this, false);
+
+    score_snapshot(vec_targets, vec_clusters_lag, vec_network_list, vec_network, bool_threads, guard.epoch());
+}
+
+void sam::score_snapshot(const std::vector<size_t>& vec_targets,
+                         const scratch_vector& vec_clusters_lag,
+                         const scratch_matrix& vec_network_list,
+                         scratch_matrix& vec_network,
+                         bool bool_threads,
+                         uint64_t uint_epoch) const
+{
+    size_t uint_num_targets = vec_targets.size();
+
+    // The locality of the row scans is tallied by the scan and published once, so that
+    // the scoring threads do not share a counter: 0 if the row is not scanned, 1 if the
+    // thread runs on the node of the row, 2 otherwise.
+    scratch_scope scope;
+    scratch_vector vec_scans(uint_num_targets, 0);
+
+    if (bool_threads && ptr_workers != nullptr)
+    {
+        ptr_workers->parallel_for(uint_num_targets, [&, this](size_t uint_cluster) {
+            if (score_cluster(vec_targets[uint_cluster], vec_clusters_lag, vec_network_list, vec_network[vec_targets[uint_cluster]], uint_epoch))
+                vec_scans[uint_cluster] = topology_node() == vec_nodes[vec_targets[uint_cluster] - cluster_begin] ? 1 : 2;
+        });
+    }
+    else if (bool_threads)
     {
-        uint_num_msg_clusters = vec_message[uint_msg_indx].size();
-        while (uint_random_cluster_counter < uint_num_msg_clusters)
+        std::vector<std::thread> workers(uint_num_targets);
+
+        std::exception_ptr error;
+        std::mutex mtx_error;
+
+        for (size_t uint_cluster = 0; uint_cluster < uint_num_targets; uint_cluster++)
         {
-            uint_randint = randint(nclusters) - 1;
-            if (!exist(vec_random_clusters[uint_msg_indx], uint_randint))
-            {
-                vec_random_clusters[uint_msg_indx].push_back(uint_randint);
-                uint_random_cluster_counter++;
-            }
+            workers[uint_cluster] = std::thread([&, this, uint_cluster]() {
+                try
+                {
+                    // the thread runs on the node that holds the row of its cluster.
+                    topology_pin(vec_nodes[vec_targets[uint_cluster] - cluster_begin]);
+                    if (score_cluster(vec_targets[uint_cluster], vec_clusters_lag, vec_network_list, vec_network[vec_targets[uint_cluster]], uint_epoch))
+                        vec_scans[uint_cluster] = topology_node() == vec_nodes[vec_targets[uint_cluster] - cluster_begin] ? 1 : 2;
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(mtx_error);
+                    if (!error) error = std::current_exception();
+                }
+            });
         }
-        uint_random_cluster_counter = 0;
-    }
 
-    // This part learns the input messages in 'vec_message' in cliques
-    // by construing the connections in the way that is elaborated in
-    // the manuscript.
-    for (size_t uint_msg_indx = 0; uint_msg_indx < uint_num_messages; uint_msg_indx++)
+        std::for_each(workers.begin(), workers.end(), std::mem_fn(&std::thread::join));
+
+        if (error) std::rethrow_exception(error);
+    }
+    else
     {
-        uint_num_msg_clusters = vec_message[uint_msg_indx].size();
-        uint_cumulative_message_length += uint_num_msg_clusters;
-        for (size_t uint_cluster = 0; uint_cluster < uint_num_msg_clusters; uint_cluster++)
+        size_t uint_node = topology_node();
+
+        for (size_t uint_cluster = 0; uint_cluster < uint_num_targets; uint_cluster++)
         {
-            for (size_t uint_cluster_ = 0; uint_cluster_ < uint_num_msg_clusters; uint_cluster_++)
-            {
-                if (uint_cluster != uint_cluster_)
-                    vec_weights
-                        [vec_random_clusters[uint_msg_indx][uint_cluster]]
-                        [vec_random_clusters[uint_msg_indx][uint_cluster_]]
-                        [vec_message[uint_msg_indx][uint_cluster] - 1]
-                        [vec_message[uint_msg_indx][uint_cluster_] - 1] = 1;
-            }
+            if (score_cluster(vec_targets[uint_cluster], vec_clusters_lag, vec_network_list, vec_network[vec_targets[uint_cluster]], uint_epoch))
+                vec_scans[uint_cluster] = uint_node == vec_nodes[vec_targets[uint_cluster] - cluster_begin] ? 1 : 2;
         }
     }
 
-    return vec_random_clusters;
+    size_t uint_local  = std::count(vec_scans.begin(), vec_scans.end(), 1);
+    size_t uint_remote = std::count(vec_scans.begin(), vec_scans.end(), 2);
+
+    if (uint_local > 0) numa_local.fetch_add(uint_local, std::memory_order_relaxed);
+    if (uint_remote > 0) numa_remote.fetch_add(uint_remote, std::memory_order_relaxed);
 }
 
-// This routine performs the blind recovery. The input parameters are the known sub-messages
-// given in 'vec_message' and their corresponding clusters given in 'vec_clusters'.
-// The default number of iterations in this recovery mode is set to one since it does not help
-// the error rate performance.
-std::vector<std::vector<size_t>> sam::recall_blind(const std::vector<size_t>& vec_message, const std::vector<size_t>& vec_clusters)
+// This routine performs the blind recovery up to the message retrieval: on return the active
+// fanals of 'vec_network' are one and 'vec_clusters_lag' lists the clusters of maximum activity.
+static void activate_blind(size_t nclusters, size_t nfanals,
+                           const std::vector<size_t>& vec_message,
+                           const std::vector<size_t>& vec_clusters,
+                           const sam::scorer& score_fn,
+                           scratch_matrix& vec_network,
+                           scratch_vector& vec_clusters_lag)
 {
-
-
     size_t uint_num_known_clusters = vec_message.size();
 
-    // The decoder data containers have been defined and initialized here.
-
-    // This two dimensional std::vector holds the computed scores of fanals in each iteration.
-    std::vector<std::vector<size_t>> vec_network(nclusters, std::vector<size_t>(nfanals));
     // This two dimensional std::vector keep the list of active fanals in each cluster.
-    std::vector<std::vector<size_t>> vec_network_list(nclusters, std::vector<size_t>(0));
-    // This std::vector holds the list of clusters that have at least one active fanal.
-    std::vector<size_t> vec_clusters_lag = vec_clusters;
+    scratch_matrix vec_network_list(nclusters, scratch_vector(0));
+    // This std::vector holds the clusters to be scored i.e. all the clusters (reused by the thread).
+    static thread_local std::vector<size_t> vec_targets;
+    vec_targets.resize(nclusters);
+
+    vec_clusters_lag.assign(vec_clusters.begin(), vec_clusters.end());
 
     for (size_t uint_cluster = 0; uint_cluster < uint_num_known_clusters; uint_cluster++)
     {
@@ -127,40 +993,19 @@ std::vector<std::vector<size_t>> sam::recall_blind(const std::vector<size_t>& ve
         vec_network[vec_clusters[uint_cluster]][vec_message[uint_cluster] - 1] = 1;
     }
 
-    // This part computes the overall scores of all fanals that are connected to the
-    // active fanals (for the first iteration step they correspond to the partial message)
-    std::vector<std::thread> workers(nclusters);
-
     for (size_t uint_cluster = 0; uint_cluster < nclusters; uint_cluster++)
     {
-        workers[uint_cluster] = std::thread([&, this, uint_cluster]() {
-
-            for (size_t uint_fanal = 0; uint_fanal < nfanals; uint_fanal++)
-            {
-                for (std::vector<size_t>::iterator itc = vec_clusters_lag.begin(); itc != vec_clusters_lag.end(); itc++)
-                {
-                    for (std::vector<size_t>::iterator itf = vec_network_list[*itc].begin(); itf != vec_network_list[*itc].end(); itf++)
-                    {
-
-                        if (this->vec_weights[uint_cluster][*itc][uint_fanal][*itf - 1] > 0)
-                        {
-                            vec_network[uint_cluster][uint_fanal]++;
-                            // 'break' is to assure a fanal receives only one signal unit from a cluster
-                            // (that may have more than one active fanal)
-                            break;
-                        }
-                    }
-                }
-            }
-        });
+        vec_targets[uint_cluster] = uint_cluster;
     }
 
-    std::for_each(workers.begin(), workers.end(), std::mem_fn(&std::thread::join));
+    // This part computes the overall scores of all fanals that are connected to the
+    // active fanals (for the first iteration step they correspond to the partial message)
+    score_fn(vec_targets, vec_clusters_lag, vec_network_list, vec_network);
 
     // This part performs a global winner-take-all.
 
-    vec_network_list = std::vector<std::vector<size_t>>(nclusters, std::vector<size_t>(0));
-    vec_clusters_lag = std::vector<size_t>(nclusters);
+    vec_network_list = scratch_matrix(nclusters, scratch_vector(0));
+    vec_clusters_lag = scratch_vector(nclusters);
 
     // obtains the maximum activity level in each cluster
     for (size_t uint_cluster = 0; uint_cluster < nclusters; uint_cluster++)
@@ -185,59 +1030,23 @@ std::vector<std::vector<size_t>> sam::recall_blind(const std::vector<size_t>& ve
                 vec_network[uint_cluster][uint_indx] = 0;
         }
     }
-
-    // message retrieval
-
-    std::vector<std::vector<size_t>> vec_retrieved(2, std::vector<size_t>(vec_clusters_lag.size()));
-
-    size_t uint_amb_counter         = 0;
-    size_t uint_cluster_counter     = 0;
-
-    for (std::vector<size_t>::iterator itc = vec_clusters_lag.begin(); itc != vec_clusters_lag.end(); itc++)
-    {
-
-        vec_retrieved[1][uint_cluster_counter] = *itc;
-
-        for (size_t uint_indx = 0; uint_indx < nfanals; uint_indx++)
-        {
-            if (vec_network[*itc][uint_indx] == 1)
-            {
-                vec_retrieved[0][uint_cluster_counter] = uint_indx + 1;
-                uint_amb_counter++;
-            }
-        }
-
-        // Fanal ambiguity detection:
-        // This part checks whether there is more than one active fanal in a cluster.
-        // In that case it returns an empty vector (see the references for more info.).
-        if (uint_amb_counter > 1)
-        {
-            return (std::vector<std::vector<size_t>>(2, std::vector<size_t>(0)));
-        }
-
-        uint_amb_counter = 0;
-        uint_cluster_counter++;
-    }
-
-    // It returns a two dimensional matrix
-    // Row 0 holds the sub-messages
-    // Row 1 holds the corresponding clusters
-    return vec_retrieved;
 }
 
-std::vector<std::vector<size_t>> sam::recall_guided(const std::vector<size_t>& vec_message,
-                                                    const std::vector<size_t>& vec_clusters,
-                                                    const std::vector<size_t>& vec_clusters_all,
-                                                    size_t uint_max_it)
+// This routine performs the guided recovery up to the message retrieval: on return the
+// active fanals of the clusters 'vec_clusters_all' of 'vec_network' are one.
+static void activate_guided(size_t nclusters, size_t nfanals,
+                            const std::vector<size_t>& vec_message,
+                            const std::vector<size_t>& vec_clusters,
+                            const std::vector<size_t>& vec_clusters_all,
+                            size_t uint_max_it,
+                            const sam::scorer& score_fn,
+                            scratch_matrix& vec_network)
 {
-
     size_t uint_num_known_clusters = vec_message.size();
     size_t nall = vec_clusters_all.size();
 
-    // classical decoder data containers
-    std::vector<std::vector<size_t>>    vec_network(nclusters, std::vector<size_t>(nfanals));
-    std::vector<std::vector<size_t>>    vec_network_list(nclusters, std::vector<size_t>(0));
-    std::vector<size_t>                 vec_clusters_lag = vec_clusters;
+    scratch_matrix  vec_network_list(nclusters, scratch_vector(0));
+    scratch_vector  vec_clusters_lag(vec_clusters.begin(), vec_clusters.end());
 
     for (size_t uint_cluster = 0; uint_cluster < uint_num_known_clusters; uint_cluster++)
     {
@@ -247,35 +1056,12 @@ std::vector<std::vector<size_t>> sam::recall_guided(const std::vector<size_t>& v
 
     for (size_t uint_it = 0; uint_it < uint_max_it; uint_it++)
     {
-        std::vector<std::thread> workers(nall);
-
-        for (size_t uint_cluster = 0; uint_cluster < nall; uint_cluster++)
-        {
-            workers[uint_cluster] = std::thread([&, this, uint_cluster]() {
-
-                for (size_t uint_fanal = 0; uint_fanal < nfanals; uint_fanal++)
-                {
-                    for (std::vector<size_t>::iterator itc = vec_clusters_lag.begin(); itc != vec_clusters_lag.end(); itc++)
-                    {
-                        for (std::vector<size_t>::iterator itf = vec_network_list[*itc].begin(); itf != vec_network_list[*itc].end(); itf++)
-                        {
-                            if (this->vec_weights[vec_clusters_all[uint_cluster]][*itc][uint_fanal][*itf - 1] > 0)
-                            {
-                                vec_network[vec_clusters_all[uint_cluster]][uint_fanal]++;
-                                break;
-                            }
-                        }
-                    }
-                }
-            });
-        }
-
-        std::for_each(workers.begin(), workers.end(), std::mem_fn(&std::thread::join));
+        score_fn(vec_clusters_all, vec_clusters_lag, vec_network_list, vec_network);
 
         // Winner-take-all
 
-        vec_network_list = std::vector<std::vector<size_t>>(nclusters, std::vector<size_t>(0));
-        vec_clusters_lag = std::vector<size_t>(nclusters, 0);
+        vec_network_list = scratch_matrix(nclusters, scratch_vector(0));
+        vec_clusters_lag = scratch_vector(nclusters, 0);
         size_t uint_max_value_fanal;
 
         // obtains the maximum activity level in each cluster
@@ -306,38 +1092,276 @@ std::vector<std::vector<size_t>> sam::recall_guided(const std::vector<size_t>& v
         }
 
     } // end of iteration
+}
 
-    // message retrieval
-
-    std::vector<std::vector<size_t>> vec_retrieved(2, std::vector<size_t>(nall));
+// message retrieval: the active fanal of each cluster in [first, last).
+template <typename iterator_t>
+static std::vector<std::vector<size_t>> retrieve(const scratch_matrix& vec_network, size_t nfanals,
+                                                 iterator_t first, iterator_t last)
+{
+    std::vector<std::vector<size_t>> vec_retrieved(2, std::vector<size_t>(last - first));
 
-    size_t uint_amb_counter     = 0;
-    size_t uint_cluster_counter = 0;
+    size_t uint_amb_counter         = 0;
+    size_t uint_cluster_counter     = 0;
 
-    for (size_t uint_cluster = 0; uint_cluster < nall; uint_cluster++)
+    for (iterator_t itc = first; itc != last; itc++)
     {
 
-        vec_retrieved[1][uint_cluster_counter] = vec_clusters_all[uint_cluster];
+        vec_retrieved[1][uint_cluster_counter] = *itc;
 
         for (size_t uint_indx = 0; uint_indx < nfanals; uint_indx++)
         {
-            if (vec_network[vec_clusters_all[uint_cluster]][uint_indx] == 1)
+            if (vec_network[*itc][uint_indx] == 1)
             {
                 vec_retrieved[0][uint_cluster_counter] = uint_indx + 1;
                 uint_amb_counter++;
             }
         }
 
-        // fanal ambiguity detection
+        // Fanal ambiguity detection:
+        // This part checks whether there is more than one active fanal in a cluster.
+        // In that case it returns an empty vector (see the references for more info.).
         if (uint_amb_counter > 1)
+        {
             return (std::vector<std::vector<size_t>>(2, std::vector<size_t>(0)));
+        }
 
         uint_amb_counter = 0;
         uint_cluster_counter++;
     }
 
-    // It returns a two dimensional std::vector
-    // row 0 holds the sub-messages
-    // row 1 holds the corresponding clusters
+    // It returns a two dimensional matrix
+    // Row 0 holds the sub-messages
+    // Row 1 holds the corresponding clusters
     return vec_retrieved;
+}
+
+// The same retrieval writing each active fanal straight into the slot of its cluster, with
+// the outcomes of cluster_slots::align: zeros on ambiguity, all ones if a cluster has no slot.
+template <typename iterator_t, typename element_t>
+static bool retrieve(const scratch_matrix& vec_network, size_t nfanals,
+                     iterator_t first, iterator_t last,
+                     const cluster_slots& slots, element_t* ptr_retrieved)
+{
+    bool bool_slotted = true;
+
+    std::fill(ptr_retrieved, ptr_retrieved + slots.size(), 0);
+
+    for (iterator_t itc = first; itc != last; itc++)
+    {
+        size_t uint_slot        = slots.slot(*itc);
+        size_t uint_amb_counter = 0;
+
+        for (size_t uint_indx = 0; uint_indx < nfanals; uint_indx++)
+        {
+            if (vec_network[*itc][uint_indx] == 1)
+            {
+                if (uint_slot != SIZE_MAX) ptr_retrieved[uint_slot] = uint_indx + 1;
+                uint_amb_counter++;
+            }
+        }
+
+        // fanal ambiguity detection
+        if (uint_amb_counter > 1)
+        {
+            std::fill(ptr_retrieved, ptr_retrieved + slots.size(), 0);
+            return true;
+        }
+
+        bool_slotted = bool_slotted && uint_slot != SIZE_MAX;
+    }
+
+    if (!bool_slotted) std::fill(ptr_retrieved, ptr_retrieved + slots.size(), std::numeric_limits<element_t>::max());
+
+    return bool_slotted;
+}
+
+// The slotted decoders, for the elements of the C++ interface and those of the flat arrays.
+template <typename element_t>
+static bool decode_blind_slots(size_t nclusters, size_t nfanals,
+                               const std::vector<size_t>& vec_message,
+                               const std::vector<size_t>& vec_clusters,
+                               const sam::scorer& score_fn,
+                               const cluster_slots& slots,
+                               element_t* ptr_retrieved)
+{
+    scratch_scope scope;
+
+    scratch_matrix vec_network(nclusters, scratch_vector(nfanals));
+    scratch_vector vec_clusters_lag;
+
+    activate_blind(nclusters, nfanals, vec_message, vec_clusters, score_fn, vec_network, vec_clusters_lag);
+
+    return retrieve(vec_network, nfanals, vec_clusters_lag.begin(), vec_clusters_lag.end(), slots, ptr_retrieved);
+}
+
+template <typename element_t>
+static bool decode_guided_slots(size_t nclusters, size_t nfanals,
+                                const std::vector<size_t>& vec_message,
+                                const std::vector<size_t>& vec_clusters,
+                                const std::vector<size_t>& vec_clusters_all,
+                                size_t uint_max_it,
+                                const sam::scorer& score_fn,
+                                const cluster_slots& slots,
+                                element_t* ptr_retrieved)
+{
+    scratch_scope scope;
+
+    scratch_matrix vec_network(nclusters, scratch_vector(nfanals));
+
+    activate_guided(nclusters, nfanals, vec_message, vec_clusters, vec_clusters_all, uint_max_it, score_fn, vec_network);
+
+    return retrieve(vec_network, nfanals, vec_clusters_all.begin(), vec_clusters_all.end(), slots, ptr_retrieved);
+}
+
+std::vector<std::vector<size_t>> sam::decode_blind(size_t nclusters, size_t nfanals,
+                                                   const std::vector<size_t>& vec_message,
+                                                   const std::vector<size_t>& vec_clusters,
+                                                   const scorer& score_fn)
+{
+    // The decoder data containers have been defined and initialized here.
+    // They come from the scratch arena of the thread, rewound at the end of the query.
+    scratch_scope scope;
+
+    // This two dimensional std::vector holds the computed scores of fanals in each iteration.
+    scratch_matrix vec_network(nclusters, scratch_vector(nfanals));
+    // This std::vector holds the list of clusters that have at least one active fanal.
+    scratch_vector vec_clusters_lag;
+
+    activate_blind(nclusters, nfanals, vec_message, vec_clusters, score_fn, vec_network, vec_clusters_lag);
+
+    return retrieve(vec_network, nfanals, vec_clusters_lag.begin(), vec_clusters_lag.end());
+}
+
+bool sam::decode_blind(size_t nclusters, size_t nfanals,
+                       const std::vector<size_t>& vec_message,
+                       const std::vector<size_t>& vec_clusters,
+                       const scorer& score_fn,
+                       const cluster_slots& slots,
+                       size_t* ptr_retrieved)
+{
+    return decode_blind_slots(nclusters, nfanals, vec_message, vec_clusters, score_fn, slots, ptr_retrieved);
+}
+
+std::vector<std::vector<size_t>> sam::decode_guided(size_t nclusters, size_t nfanals,
+                                                    const std::vector<size_t>& vec_message,
+                                                    const std::vector<size_t>& vec_clusters,
+                                                    const std::vector<size_t>& vec_clusters_all,
+                                                    size_t uint_max_it,
+                                                    const scorer& score_fn)
+{
+    // classical decoder data containers (from the scratch arena of the thread)
+    scratch_scope scope;
+
+    scratch_matrix vec_network(nclusters, scratch_vector(nfanals));
+
+    activate_guided(nclusters, nfanals, vec_message, vec_clusters, vec_clusters_all, uint_max_it, score_fn, vec_network);
+
+    return retrieve(vec_network, nfanals, vec_clusters_all.begin(), vec_clusters_all.end());
+}
+
+bool sam::decode_guided(size_t nclusters, size_t nfanals,
+                        const std::vector<size_t>& vec_message,
+                        const std::vector<size_t>& vec_clusters,
+                        const std::vector<size_t>& vec_clusters_all,
+                        size_t uint_max_it,
+                        const scorer& score_fn,
+                        const cluster_slots& slots,
+                        size_t* ptr_retrieved)
+{
+    return decode_guided_slots(nclusters, nfanals, vec_message, vec_clusters, vec_clusters_all, uint_max_it, score_fn, slots, ptr_retrieved);
+}
+
+// the order of the rows of the flat arrays: the slot of a cluster is the cluster itself.
+static cluster_slots flat_slots(size_t nclusters)
+{
+    std::vector<size_t> vec_clusters(nclusters);
+    std::iota(vec_clusters.begin(), vec_clusters.end(), 0);
+
+    cluster_slots slots(nclusters);
+    slots.assign(vec_clusters);
+
+    return slots;
+}
+
+// The few elements of a query are copied into vectors of the worker reused from one
+// query to the next, and the decoder writes the retrieved message straight into the
+// row of the query.
+void sam::recall_blind_flat(const dataset& queries, uint32_t* ptr_retrieved)
+{
+    if (queries.fanals() > nfanals || queries.clusters() > nclusters)
+        throw std::invalid_argument("the messages do not fit in the network");
+
+    if (queries.size() == 0) return;
+
+    if (ptr_retrieved == nullptr) throw std::invalid_argument("no buffer for the retrieved messages");
+
+    cluster_slots slots = flat_slots(nclusters);
+
+    parallel_for(queries.size(), [&, this](size_t uint_query) {
+        static thread_local std::vector<size_t> vec_message, vec_clusters, vec_clusters_all;
+        file_query(queries, uint_query, 0, vec_message, vec_clusters, vec_clusters_all);
+
+        epoch_guard guard(epochs);
+        storage_lock lock(*this, false);
+
+        uint64_t uint_epoch = guard.epoch();
+
+        decode_blind_slots(nclusters, nfanals, vec_message, vec_clusters,
+                           [this, uint_epoch](const std::vector<size_t>& vec_targets, const scratch_vector& vec_clusters_lag,
+                                              const scratch_matrix& vec_network_list, scratch_matrix& vec_network) {
+                               score_snapshot(vec_targets, vec_clusters_lag, vec_network_list, vec_network, false, uint_epoch);
+                           },
+                           slots, ptr_retrieved + uint_query * nclusters);
+    });
+}
+
+void sam::recall_guided_flat(const dataset& queries,
+                             const uint64_t* ptr_offsets_all,
+                             const uint32_t* ptr_clusters_all,
+                             size_t uint_max_it,
+                             uint32_t* ptr_retrieved)
+{
+    if (queries.fanals() > nfanals || queries.clusters() > nclusters)
+        throw std::invalid_argument("the messages do not fit in the network");
+
+    if (queries.size() == 0) return;
+
+    if (ptr_retrieved == nullptr) throw std::invalid_argument("no buffer for the retrieved messages");
+    if (ptr_offsets_all == nullptr) throw std::invalid_argument("malformed clusters");
+
+    bool bool_valid = ptr_offsets_all[0] == 0 && (ptr_clusters_all != nullptr || ptr_offsets_all[queries.size()] == 0);
+
+    for (size_t uint_query = 0; bool_valid && uint_query < queries.size(); uint_query++)
+    {
+        bool_valid = ptr_offsets_all[uint_query] <= ptr_offsets_all[uint_query + 1];
+    }
+
+    for (size_t uint_indx = 0; bool_valid && uint_indx < ptr_offsets_all[queries.size()]; uint_indx++)
+    {
+        bool_valid = ptr_clusters_all[uint_indx] < nclusters;
+    }
+
+    if (!bool_valid) throw std::invalid_argument("malformed clusters");
+
+    cluster_slots slots = flat_slots(nclusters);
+
+    parallel_for(queries.size(), [&, this](size_t uint_query) {
+        static thread_local std::vector<size_t> vec_message, vec_clusters, vec_clusters_all;
+        file_query(queries, uint_query, 0, vec_message, vec_clusters, vec_clusters_all);
+
+        vec_clusters_all.assign(ptr_clusters_all + ptr_offsets_all[uint_query], ptr_clusters_all + ptr_offsets_all[uint_query + 1]);
+
+        epoch_guard guard(epochs);
+        storage_lock lock(*this, false);
+
+        uint64_t uint_epoch = guard.epoch();
+
+        decode_guided_slots(nclusters, nfanals, vec_message, vec_clusters, vec_clusters_all, uint_max_it,
+                            [this, uint_epoch](const std::vector<size_t>& vec_targets, const scratch_vector& vec_clusters_lag,
+                                               const scratch_matrix& vec_network_list, scratch_matrix& vec_network) {
+                                score_snapshot(vec_targets, vec_clusters_lag, vec_network_list, vec_network, false, uint_epoch);
+                            },
+                            slots, ptr_retrieved + uint_query * nclusters);
+    });
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+/**
+ * @file sam.h
+ * @brief C interface of the Sparse Associative Memory (libsam.so)
+ *
+ * The messages are passed as flat arrays owned by the caller and read in place:
+ *
+ * - offsets[count + 1]: the first element of each message and the total number of elements,
+ * - elements[offsets[count]]: the elements, from one to nf,
+ * - clusters[offsets[count]]: the cluster of each element, or NULL for the element positions.
+ *
+ * A recall writes nc elements per query into the caller's buffer: the element retrieved
+ * in each cluster, or zero if none. The functions return SAM_OK or a negative error code
+ * and sam_error describes the last error of the calling thread.
+ */
+#ifndef __SAM_H__
+#define __SAM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAM_API __attribute__((visibility("default")))
+
+#define SAM_OK                  0
+#define SAM_ERROR_ARGUMENT     -1  /* malformed messages or messages that do not fit in the network */
+#define SAM_ERROR_MEMORY       -2  /* out of memory */
+#define SAM_ERROR_FAILURE      -3  /* any other failure (e.g. a file that cannot be read) */
+
+#define SAM_STORAGE_DENSE       0  /* one byte per connection */
+#define SAM_STORAGE_BLOCKS      1  /* compressed blocks for large alphabets (nf < 65536) */
+
+/** @brief a network (opaque). */
+typedef struct sam_network sam_network;
+
+/** @brief creates an empty network of 'nc' clusters of 'nf' fanals (NULL on failure, e.g. a zero size). */
+SAM_API sam_network* sam_create(size_t nc, size_t nf, int storage);
+
+/** @brief destroys a network. */
+SAM_API void sam_destroy(sam_network* network);
+
+/** @brief the number of clusters of a network. */
+SAM_API size_t sam_clusters(const sam_network* network);
+
+/** @brief the number of fanals of each cluster of a network. */
+SAM_API size_t sam_fanals(const sam_network* network);
+
+/** @brief learns 'count' messages. */
+SAM_API int sam_learn(sam_network* network, size_t count,
+                      const uint64_t* offsets, const uint32_t* elements, const uint32_t* clusters);
+
+/**
+ * @brief recalls 'count' queries (the known sub-messages) by blind recall.
+ * @param retrieved the retrieved messages (count * nc elements).
+ */
+SAM_API int sam_recall_blind(sam_network* network, size_t count,
+                             const uint64_t* offsets, const uint32_t* elements, const uint32_t* clusters,
+                             uint32_t* retrieved);
+
+/**
+ * @brief recalls 'count' queries (the known sub-messages) by guided recall.
+ * @param offsets_all the first cluster of each query in 'clusters_all' (count + 1).
+ * @param clusters_all the clusters of all the elements of the queries.
+ * @param max_it the maximum number of iterations.
+ * @param retrieved the retrieved messages (count * nc elements).
+ */
+SAM_API int sam_recall_guided(sam_network* network, size_t count,
+                              const uint64_t* offsets, const uint32_t* elements, const uint32_t* clusters,
+                              const uint64_t* offsets_all, const uint32_t* clusters_all,
+                              size_t max_it, uint32_t* retrieved);
+
+/** @brief erases all the messages of a network. */
+SAM_API void sam_reset(sam_network* network);
+
+/** @brief saves a network (dense storage). */
+SAM_API int sam_save(const sam_network* network, const char* filename);
+
+/** @brief loads a network saved with the same parameters (dense storage). */
+SAM_API int sam_load(sam_network* network, const char* filename);
+
+/** @brief the description of the last error of the calling thread. */
+SAM_API const char* sam_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -22,8 +22,24 @@
 #include <ctime>
 #include <thread>
 #include <algorithm>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <future>
+#include <exception>
+#include <pthread.h>
+
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+#include <coroutine>
+#define SAM_COROUTINES
+#endif
 
 #include "utility.hpp"
+#include "block.hpp"
+#include "dataset.hpp"
+#include "topology.hpp"
+#include "epoch.hpp"
+#include "workers.hpp"
 
 /**
  * @class sam
@@ -33,26 +49,96 @@
  * The class implements the Sparse Associative Memory (SAM)
  * described in the given references.
  *
+ * Each row of the weight tensor, i.e. the connections towards one target
+ * cluster, is a contiguous block of memory aligned to a cache line. On a NUMA
+ * system the rows are spread over the nodes in contiguous ranges of target
+ * clusters and the threads that score a cluster are pinned to the node that
+ * holds its row. The rows of a node share one region backed by huge pages
+ * when possible (see topology.hpp).
+ *
+ * The messages can be learned while other threads recall: every recall works on
+ * a snapshot of the network that holds the messages learned before it started
+ * (see epoch.hpp). A learn call publishes its messages in chunks, each message
+ * becoming visible at once. The other methods (reset, load) must not run
+ * concurrently with any other method.
+ *
+ * Along with the dense weight tensor, learn maintains two occupancy summaries:
+ * a bit per (target cluster, source cluster) block that holds a connection and
+ * a bit per source fanal that has a connection towards a target cluster. The scoring
+ * step drops the empty blocks and the unconnected active fanals before it probes
+ * the connections, and skips a target cluster with no connection at all.
+ *
+ * The dense weight tensor takes nc * nc * nf * nf bytes, which rules out large
+ * alphabets. The block storage (storage_blocks) rather keeps every (target cluster,
+ * source cluster) block in a compressed container chosen by its fill (see block.hpp),
+ * so its memory follows the number of connections. A learn call then excludes the
+ * recalls (a readers-writer lock) instead of publishing snapshots, and the network
+ * cannot be saved or loaded.
+ *
+ * A network may also be hosted by a pool of networks (see sam_pool) that holds
+ * its rows in a shared arena and runs its threads on shared workers.
  */
 class sam
 {
 
   public:
+    /**
+     * @brief the storage of the connections.
+     */
+    enum storage
+    {
+        storage_dense,  //!< one byte per connection (the default)
+        storage_blocks, //!< compressed blocks for large alphabets (nf < 65536)
+    };
+
    /**
     * @brief constructor
     * @param nc the total number of clusters in the network.
     * @param nf the total number of fanals in each cluster.
+    * @param backend the storage of the connections.
     *
     * The number of none zero elements in each message is limited
     * by the total number of clusters. An element of a message
     * is a number (index of the element in an alphabet) limited
     * by the total number of fanals.
     */
-    sam(size_t nc, size_t nf);
+    sam(size_t nc, size_t nf, storage backend = storage_dense);
+
+    /**
+     * @brief constructor of a network shard
+     * @param nc the total number of clusters in the network.
+     * @param nf the total number of fanals in each cluster.
+     * @param cluster_begin the first target cluster owned by the shard.
+     * @param cluster_end one past the last target cluster owned by the shard.
+     * @param backend the storage of the connections.
+     *
+     * A shard only stores the connections whose target cluster lies in
+     * [cluster_begin, cluster_end), i.e. a contiguous range of rows of the
+     * weight tensor, and only scores the fanals of those clusters.
+     * The shards of a network are driven by a coordinator (see sam_sharded).
+     */
+    sam(size_t nc, size_t nf, size_t cluster_begin, size_t cluster_end, storage backend = storage_dense);
 
     //! destructor
     ~sam();
 
+    sam(const sam&) = delete;
+    sam& operator=(const sam&) = delete;
+
+    /**
+     * @brief counters of the weight row scans by NUMA locality.
+     */
+    struct numa_counters
+    {
+        size_t nodes;  //!< the number of NUMA nodes holding the weights
+        size_t local;  //!< the row scans by a thread running on the node of the row
+        size_t remote; //!< the row scans by a thread running on another node
+    };
+
+    //! the NUMA counters since the construction of the network.
+    numa_counters numa() const;
+
+
     /**
      * @brief learn a single message i.e. word.
      * @param vec_message the vector of message elements.
@@ -62,6 +148,24 @@ class sam
      */
     std::vector<std::vector<size_t>> learn(const std::vector<std::vector<size_t>>& vec_message);
 
+    /**
+     * @brief learn a set of messages in the given clusters.
+     * @param vec_message the vector of message elements.
+     * @param vec_clusters the clusters of the message elements.
+     *
+     * A shard only stores the connections towards the clusters it owns.
+     */
+    void learn(const std::vector<std::vector<size_t>>& vec_message, const std::vector<std::vector<size_t>>& vec_clusters);
+
+    /**
+     * @brief learn the messages of a message file in their clusters.
+     * @param data the mapped message file (see dataset).
+     *
+     * The messages are read in place from the mapping. It throws std::invalid_argument
+     * if the elements or the clusters of the file exceed the ones of the network.
+     */
+    void learn(const dataset& data);
+
     /**
      * @brief recall the entire message given a few of its elements (a partially known message)
      *
@@ -78,17 +182,474 @@ class sam
                                                    const std::vector<size_t>& vec_clusters_all,
                                                    size_t uint_max_it);
 
+    /**
+     * @brief blind recall writing the retrieved message into a buffer in the order of 'slots'.
+     * @param ptr_retrieved the retrieved elements, one per slot (see cluster_slots::align).
+     * @return false if a retrieved cluster has no slot.
+     */
+    bool recall_blind(const std::vector<size_t>& vec_message,
+                      const std::vector<size_t>& vec_clusters,
+                      const cluster_slots& slots,
+                      size_t* ptr_retrieved);
+
+    /**
+     * @brief guided recall writing the retrieved message into a buffer in the order of 'slots'.
+     */
+    bool recall_guided(const std::vector<size_t>& vec_message,
+                       const std::vector<size_t>& vec_clusters,
+                       const std::vector<size_t>& vec_clusters_all,
+                       size_t uint_max_it,
+                       const cluster_slots& slots,
+                       size_t* ptr_retrieved);
+
+    /**
+     * @brief recall a batch of partially known messages by blind recall.
+     * @param vec_messages the known sub-messages of each query.
+     * @param vec_clusters the clusters of the known sub-messages of each query.
+     * @return one retrieved message per query (see recall_blind).
+     *
+     * The queries are spread over the available cores and each query is decoded
+     * by a single thread, which amortizes the thread start-up cost of recall_blind
+     * over the whole batch.
+     */
+    std::vector<std::vector<std::vector<size_t>>> recall_blind_batch(const std::vector<std::vector<size_t>>& vec_messages,
+                                                                     const std::vector<std::vector<size_t>>& vec_clusters);
+
+    /**
+     * @brief recall a batch of partially known messages by guided recall.
+     * @return one retrieved message per query (see recall_guided).
+     */
+    std::vector<std::vector<std::vector<size_t>>> recall_guided_batch(const std::vector<std::vector<size_t>>& vec_messages,
+                                                                      const std::vector<std::vector<size_t>>& vec_clusters,
+                                                                      const std::vector<std::vector<size_t>>& vec_clusters_all,
+                                                                      size_t uint_max_it);
+
+    /**
+     * @brief recall the messages of a message file by blind recall.
+     * @param data the mapped message file (see dataset).
+     * @param uint_num_erased the number of unknown elements at the end of each message.
+     * @return one retrieved message per message of the file (see recall_blind).
+     */
+    std::vector<std::vector<std::vector<size_t>>> recall_blind_batch(const dataset& data, size_t uint_num_erased);
+
+    /**
+     * @brief recall the messages of a message file by guided recall (the clusters of all the elements are known).
+     * @return one retrieved message per message of the file (see recall_guided).
+     */
+    std::vector<std::vector<std::vector<size_t>>> recall_guided_batch(const dataset& data, size_t uint_num_erased, size_t uint_max_it);
+
+    /**
+     * @brief recall a batch of queries held in flat arrays by blind recall.
+     * @param queries the known sub-messages and their clusters (see dataset).
+     * @param ptr_retrieved the retrieved messages, 'nc' elements per query: the element
+     *        retrieved in each cluster, or zero if none (nothing is retrieved on failure).
+     *
+     * The queries are read and the messages written in place, as for recall_blind_batch.
+     * It throws std::invalid_argument if the queries do not fit in the network.
+     */
+    void recall_blind_flat(const dataset& queries, uint32_t* ptr_retrieved);
+
+    /**
+     * @brief recall a batch of queries held in flat arrays by guided recall.
+     * @param ptr_offsets_all the first cluster of each query in 'ptr_clusters_all' (and their total number).
+     * @param ptr_clusters_all the clusters of all the elements of the queries.
+     *
+     * See recall_blind_flat and recall_guided.
+     */
+    void recall_guided_flat(const dataset& queries,
+                            const uint64_t* ptr_offsets_all,
+                            const uint32_t* ptr_clusters_all,
+                            size_t uint_max_it,
+                            uint32_t* ptr_retrieved);
+
+    /**
+     * @brief the completion callback of an asynchronous recall.
+     *
+     * It receives the retrieved message, or the exception thrown by the recall (and an empty
+     * message). It runs on a worker thread and must not throw.
+     */
+    typedef std::function<void(std::vector<std::vector<size_t>>&& vec_retrieved, std::exception_ptr error)> recall_callback;
+
+    /**
+     * @brief starts a blind recall on the workers and returns at once.
+     * @return the future retrieved message (see recall_blind).
+     *
+     * The query is decoded by a single worker: the workers of the pool hosting the network,
+     * or else the workers shared by the process (see worker_pool::shared). Many recalls may
+     * be in flight and overlap learn calls as any other recall. A standalone network must
+     * outlive the recalls it has started (a pool waits for them before destroying its networks).
+     */
+    std::future<std::vector<std::vector<size_t>>> recall_blind_async(const std::vector<size_t>& vec_message,
+                                                                     const std::vector<size_t>& vec_clusters) const;
+
+    /**
+     * @brief starts a blind recall on the workers and calls 'done' once it completes.
+     *
+     * It throws std::invalid_argument if 'done' is empty, before anything is queued.
+     */
+    void recall_blind_async(const std::vector<size_t>& vec_message,
+                            const std::vector<size_t>& vec_clusters,
+                            recall_callback done) const;
+
+    /**
+     * @brief starts a guided recall on the workers and returns at once.
+     * @return the future retrieved message (see recall_guided).
+     */
+    std::future<std::vector<std::vector<size_t>>> recall_guided_async(const std::vector<size_t>& vec_message,
+                                                                      const std::vector<size_t>& vec_clusters,
+                                                                      const std::vector<size_t>& vec_clusters_all,
+                                                                      size_t uint_max_it) const;
+
+    /**
+     * @brief starts a guided recall on the workers and calls 'done' once it completes.
+     *
+     * It throws std::invalid_argument if 'done' is empty, before anything is queued.
+     */
+    void recall_guided_async(const std::vector<size_t>& vec_message,
+                             const std::vector<size_t>& vec_clusters,
+                             const std::vector<size_t>& vec_clusters_all,
+                             size_t uint_max_it,
+                             recall_callback done) const;
+
+#ifdef SAM_COROUTINES
+    /**
+     * @brief an asynchronous recall awaited by a C++20 coroutine.
+     *
+     * The recall starts when the coroutine suspends on it, which then resumes on the worker
+     * that completed it. The retrieved message is the result of the co_await expression.
+     */
+    class recall_awaitable
+    {
+      public:
+        explicit recall_awaitable(std::function<void(recall_callback)> start) : start(std::move(start)) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            // the coroutine may resume, and destroy the awaitable, before 'start' returns.
+            std::function<void(recall_callback)> start = std::move(this->start);
+
+            start([this, handle](std::vector<std::vector<size_t>>&& vec_retrieved, std::exception_ptr error) {
+                this->vec_retrieved = std::move(vec_retrieved);
+                this->error         = error;
+                handle.resume();
+            });
+        }
+
+        std::vector<std::vector<size_t>> await_resume()
+        {
+            if (error) std::rethrow_exception(error);
+            return std::move(vec_retrieved);
+        }
+
+      private:
+        std::function<void(recall_callback)> start;
+        std::vector<std::vector<size_t>> vec_retrieved;
+        std::exception_ptr error;
+    };
+
+    //! a blind recall to co_await (see recall_blind_async).
+    recall_awaitable recall_blind_await(std::vector<size_t> vec_message, std::vector<size_t> vec_clusters) const
+    {
+        return recall_awaitable([=, this](recall_callback done) {
+            recall_blind_async(vec_message, vec_clusters, std::move(done));
+        });
+    }
+
+    //! a guided recall to co_await (see recall_guided_async).
+    recall_awaitable recall_guided_await(std::vector<size_t> vec_message,
+                                         std::vector<size_t> vec_clusters,
+                                         std::vector<size_t> vec_clusters_all,
+                                         size_t uint_max_it) const
+    {
+        return recall_awaitable([=, this](recall_callback done) {
+            recall_guided_async(vec_message, vec_clusters, vec_clusters_all, uint_max_it, std::move(done));
+        });
+    }
+#endif
+
+    /**
+     * @brief the size in bytes of the weight tensor of a dense network of 'nc' clusters of 'nf' fanals.
+     *
+     * It is the memory a network takes in the arena of a pool (see sam_pool).
+     */
+    static size_t region_size(size_t nc, size_t nf);
+
+    /**
+     * @brief the scoring step of the decoders.
+     *
+     * The scorer sets the activity of the fanals of every cluster in 'vec_targets' (first argument)
+     * given the active fanals 'vec_network_list' (third argument) of the active clusters
+     * 'vec_clusters_lag' (second argument). The activity of a fanal is one if it is active plus the
+     * number of active clusters it is connected to. The activities are stored in 'vec_network'
+     * (fourth argument) whose target rows hold the indicator of the active fanals on entry.
+     * An activity below the maximum activity of its cluster may be reported as zero
+     * since the winner-take-all only keeps the fanals with the maximum activity.
+     */
+    typedef std::function<void(const std::vector<size_t>&,
+                               const scratch_vector&,
+                               const scratch_matrix&,
+                               scratch_matrix&)> scorer;
+
+    /**
+     * @brief computes the activities of the fanals of the target clusters (see scorer).
+     * @param bool_threads true to score each target cluster in its own thread.
+     *
+     * The activities are computed in a snapshot of the network taken at the call.
+     *
+     * All target clusters must be owned by this instance.
+     */
+    void score(const std::vector<size_t>& vec_targets,
+               const scratch_vector& vec_clusters_lag,
+               const scratch_matrix& vec_network_list,
+               scratch_matrix& vec_network,
+               bool bool_threads) const;
+
+    /**
+     * @brief blind recall of a network of 'nc' clusters of 'nf' fanals given its scoring step.
+     */
+    static std::vector<std::vector<size_t>> decode_blind(size_t nc, size_t nf,
+                                                         const std::vector<size_t>& vec_message,
+                                                         const std::vector<size_t>& vec_clusters,
+                                                         const scorer& score_fn);
+
+    /**
+     * @brief guided recall of a network of 'nc' clusters of 'nf' fanals given its scoring step.
+     */
+    static std::vector<std::vector<size_t>> decode_guided(size_t nc, size_t nf,
+                                                          const std::vector<size_t>& vec_message,
+                                                          const std::vector<size_t>& vec_clusters,
+                                                          const std::vector<size_t>& vec_clusters_all,
+                                                          size_t uint_max_it,
+                                                          const scorer& score_fn);
+
+    /**
+     * @brief blind recall writing the retrieved message into a buffer in the order of 'slots'.
+     * @return false if a retrieved cluster has no slot (see cluster_slots::align).
+     */
+    static bool decode_blind(size_t nc, size_t nf,
+                             const std::vector<size_t>& vec_message,
+                             const std::vector<size_t>& vec_clusters,
+                             const scorer& score_fn,
+                             const cluster_slots& slots,
+                             size_t* ptr_retrieved);
+
+    /**
+     * @brief guided recall writing the retrieved message into a buffer in the order of 'slots'.
+     */
+    static bool decode_guided(size_t nc, size_t nf,
+                              const std::vector<size_t>& vec_message,
+                              const std::vector<size_t>& vec_clusters,
+                              const std::vector<size_t>& vec_clusters_all,
+                              size_t uint_max_it,
+                              const scorer& score_fn,
+                              const cluster_slots& slots,
+                              size_t* ptr_retrieved);
+
+    /**
+     * @brief checks whether a message has been learned in the given clusters.
+     * @return true if all the connections of the message clique exist.
+     */
+    bool contains(const std::vector<size_t>& vec_message, const std::vector<size_t>& vec_clusters) const;
+
     /**
      * @brief reset the associative memory to the initial state (erase learned messages).
      */
     void reset();
 
+    /**
+     * @brief write the network parameters and the connections into a binary file.
+     * @return true on success, false if the file cannot be written, this instance is a shard
+     * or it uses the block storage.
+     */
+    bool save(const char* filename) const;
+
+    /**
+     * @brief read the connections from a binary file written by save().
+     * @return true on success, false if the file cannot be read, its
+     * network parameters differ from the ones of this instance or it uses the block storage.
+     *
+     * A shard only reads the rows of the weight tensor it owns.
+     */
+    bool load(const char* filename);
+
+    /**
+     * @brief read the network parameters of a binary file written by save().
+     * @return true on success.
+     */
+    static bool probe(const char* filename, size_t& nc, size_t& nf);
+
+    //! the total number of clusters in the network.
+    size_t clusters() const { return nclusters; }
+
+    //! the number of fanals in each cluster.
+    size_t fanals() const { return nfanals; }
+
+    //! the storage of the connections.
+    storage backend() const { return storage_backend; }
+
+    //! the memory taken by the connections in bytes.
+    size_t bytes() const;
+
+    //! the first target cluster owned by this instance.
+    size_t begin() const { return cluster_begin; }
+
+    //! one past the last target cluster owned by this instance.
+    size_t end() const { return cluster_end; }
+
   private:
-    std::vector<std::vector<std::vector<std::vector<char>>>> vec_weights;
+    friend class sam_pool;
+
+    // constructor of a network hosted by a pool: the dense weight tensor lies in the zeroed memory
+    // at 'ptr_weights' (region_size bytes) and the network shares the epochs and the workers of the pool.
+    sam(size_t nc, size_t nf, unsigned char* ptr_weights, epoch_domain& domain, worker_pool& workers);
+
+    // holds the readers-writer lock of the block storage for the lifetime of the object.
+    class storage_lock
+    {
+      public:
+        storage_lock(const sam& memory, bool bool_write);
+        ~storage_lock();
+
+      private:
+        const sam& memory;
+    };
+
+    // computes the scores of the fanals of cluster 'uint_cluster' given the active fanals in the snapshot 'uint_epoch'.
+    bool score_cluster(size_t uint_cluster,
+                       const scratch_vector& vec_clusters_lag,
+                       const scratch_matrix& vec_network_list,
+                       scratch_vector& vec_scores,
+                       uint64_t uint_epoch) const;
+
+    // computes the scores of the fanals of cluster 'uint_cluster' in the block storage.
+    void score_cluster_blocks(size_t uint_cluster,
+                              const scratch_vector& vec_clusters_lag,
+                              const scratch_matrix& vec_network_list,
+                              scratch_vector& vec_scores) const;
+
+    // learns the messages given by the accessors size(), length(i), element(i, j) and cluster(i, j).
+    template <typename messages_t> void learn_messages(const messages_t& messages);
+
+    // learns the messages in the block storage.
+    template <typename messages_t> void learn_blocks(const messages_t& messages);
+
+    // recalls a message in a snapshot, scoring the target clusters in parallel if 'bool_threads'.
+    std::vector<std::vector<size_t>> recall_blind_snapshot(const std::vector<size_t>& vec_message,
+                                                           const std::vector<size_t>& vec_clusters,
+                                                           bool bool_threads) const;
+
+    std::vector<std::vector<size_t>> recall_guided_snapshot(const std::vector<size_t>& vec_message,
+                                                            const std::vector<size_t>& vec_clusters,
+                                                            const std::vector<size_t>& vec_clusters_all,
+                                                            size_t uint_max_it,
+                                                            bool bool_threads) const;
+
+    // the workers that run the asynchronous recalls.
+    worker_pool& async_workers() const { return ptr_workers != nullptr ? *ptr_workers : worker_pool::shared(); }
+
+    // calls 'query_fn' for the queries [0, uint_num_queries) spread over the cores.
+    void parallel_for(size_t uint_num_queries, const std::function<void(size_t)>& query_fn) const;
+
+    // the scoring step of the decoders in the snapshot 'uint_epoch'.
+    void score_snapshot(const std::vector<size_t>& vec_targets,
+                        const scratch_vector& vec_clusters_lag,
+                        const scratch_matrix& vec_network_list,
+                        scratch_matrix& vec_network,
+                        bool bool_threads,
+                        uint64_t uint_epoch) const;
+
+    // the size of a row of the weight tensor in bytes.
+    size_t row_size() const { return nclusters * nfanals * nfanals; }
+
+    // the distance between two rows of the weight tensor in a region.
+    size_t row_stride() const { return (row_size() + TOPOLOGY_ALIGNMENT - 1) / TOPOLOGY_ALIGNMENT * TOPOLOGY_ALIGNMENT; }
+
+    // the connection from the fanal 'fi' of the owned cluster 'ci' to the fanal 'fj' of the cluster 'cj'.
+    unsigned char& weight(size_t ci, size_t cj, size_t fi, size_t fj) const
+    {
+        return vec_weights[ci - cluster_begin][(cj * nfanals + fi) * nfanals + fj];
+    }
+
+    // the block of the connections from the source cluster 'cj' to the owned target cluster 'ci'.
+    block& connections(size_t ci, size_t cj) const
+    {
+        return vec_blocks[(ci - cluster_begin) * nclusters + cj];
+    }
+
+    // the key of the connection from the source fanal 'fj' to the target fanal 'fi' in a block.
+    uint32_t key(size_t fi, size_t fj) const
+    {
+        return fj * nfanals + fi;
+    }
+
+    // marks the block (ci, cj) and the source fanal 'fj' of 'cj' as connected towards 'ci' (dense storage).
+    void occupy(size_t ci, size_t cj, size_t fj)
+    {
+        uint64_t* ptr_block = &vec_occupied_blocks[(ci - cluster_begin) * words(nclusters) + cj / 64];
+        uint64_t* ptr_fanal = &vec_occupied_fanals[((ci - cluster_begin) * nclusters + cj) * words(nfanals) + fj / 64];
+
+        // the bits only grow, so they are set before the connection is tagged and are tested before writing.
+        if (!((__atomic_load_n(ptr_fanal, __ATOMIC_RELAXED) >> (fj % 64)) & 1))
+            __atomic_fetch_or(ptr_fanal, 1ULL << (fj % 64), __ATOMIC_RELAXED);
+        if (!((__atomic_load_n(ptr_block, __ATOMIC_RELAXED) >> (cj % 64)) & 1))
+            __atomic_fetch_or(ptr_block, 1ULL << (cj % 64), __ATOMIC_RELAXED);
+    }
+
+    // true if the block (ci, cj) may hold a connection.
+    bool occupied(size_t ci, size_t cj) const
+    {
+        return (__atomic_load_n(&vec_occupied_blocks[(ci - cluster_begin) * words(nclusters) + cj / 64], __ATOMIC_RELAXED) >> (cj % 64)) & 1;
+    }
+
+    // true if the source fanal 'fj' of 'cj' may have a connection towards 'ci'.
+    bool occupied(size_t ci, size_t cj, size_t fj) const
+    {
+        return (__atomic_load_n(&vec_occupied_fanals[((ci - cluster_begin) * nclusters + cj) * words(nfanals) + fj / 64], __ATOMIC_RELAXED) >> (fj % 64)) & 1;
+    }
+
+    // the number of 64 bit words of a bitmap of 'n' bits.
+    static size_t words(size_t n) { return (n + 63) / 64; }
+
+    // rebuilds the occupancy summaries from the weight tensor.
+    void summarize();
+
+    // drops the logged connections of the network from its epochs.
+    void forget_epochs();
+
+    // the rows of the weight tensor of the owned target clusters (indexed from 'cluster_begin')
+    std::vector<unsigned char*> vec_weights;
+    // the memory regions holding the rows, one per NUMA node (or the memory given by a pool)
+    std::vector<unsigned char*> vec_regions;
+    std::vector<size_t> vec_region_sizes;
+    // the NUMA node of each row
+    std::vector<size_t> vec_nodes;
+    // the occupancy summaries of the owned target clusters (dense storage)
+    mutable std::vector<uint64_t> vec_occupied_blocks;
+    mutable std::vector<uint64_t> vec_occupied_fanals;
+    // the blocks of the owned target clusters (block storage)
+    mutable std::vector<block> vec_blocks;
+    // excludes the recalls from a learn call (block storage)
+    mutable pthread_rwlock_t rwl_blocks;
+
+    mutable std::atomic<size_t> numa_local;
+    mutable std::atomic<size_t> numa_remote;
+
+    // the snapshots of the readers and the epochs of the writers (shared by the networks of a pool)
+    std::unique_ptr<epoch_domain> own_epochs;
+    epoch_domain& epochs;
+
+    // the workers of the pool hosting the network (none if standalone)
+    worker_pool* ptr_workers;
 
     size_t nclusters; // The total number of clusters in the network
     size_t nfanals;   // The number of fanals in each cluster
+    size_t cluster_begin; // The first owned target cluster
+    size_t cluster_end;   // One past the last owned target cluster
     size_t ncores;
+
+    storage storage_backend;
 };
 
 #endif
@@ -0,0 +1,688 @@
+/**
+ * @file serve.cxx
+ * @brief Sparse Associative Memory (SAM) recall daemon
+ *
+ * The daemon holds a single copy of the network and serves learn, recall
+ * and contains requests of many local clients over a Unix domain socket
+ * (see protocol.hpp for the binary protocol).
+ *
+ * Each client connection is served by its own thread that parses the requests
+ * and hands them to the batcher. The batcher coalesces the requests that arrive
+ * within a short window into a micro-batch and executes it with the batch recall
+ * routines of the network, so concurrent clients share the throughput of batched
+ * recall while each of them still sees a low latency.
+ *
+ * Given a cluster range (--range), the daemon rather serves a shard of a network
+ * that only owns the given target clusters (see shard.hpp) to a coordinator.
+ */
+
+#include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <stdexcept>
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <map>
+#include <list>
+#include <memory>
+#include <atomic>
+
+#include "sam.hpp"
+#include "protocol.hpp"
+#include "shard.hpp"
+
+#define CWIDTH          15
+#define USAGE_STDERR    std::cerr << std::left << std::setw(CWIDTH)
+
+// network parameters (overridden by the network file if any)
+
+size_t nc               = 100; // The total number of clusters in the network
+size_t nf               = 64;  // The number of fanals in each cluster
+size_t range_begin      = 0;   // The first owned target cluster (shard mode)
+size_t range_end        = 0;   // One past the last owned target cluster (shard mode)
+
+// batching parameters
+
+size_t max_batch        = 64;  // The maximum number of requests in a micro-batch
+size_t window_us        = 200; // The time a request may wait for the micro-batch to fill (us)
+
+const char* socket_path = "/tmp/sam.sock";
+const char* load_file   = nullptr;
+const char* save_file   = nullptr;
+
+volatile sig_atomic_t running = 1;
+
+typedef std::chrono::steady_clock clock_type;
+
+/**
+ * @brief a pending request along with its response.
+ */
+struct job
+{
+    sam_request_header                  header;
+    std::vector<size_t>                 vec_message;
+    std::vector<size_t>                 vec_clusters;
+    std::vector<size_t>                 vec_clusters_all;
+
+    sam_response_header                 response;
+    std::vector<uint32_t>               vec_payload;
+
+    clock_type::time_point              time_arrival;
+    std::promise<void>                  done;
+};
+
+/**
+ * @brief latency and throughput counters of the daemon.
+ */
+struct counters
+{
+    std::atomic<uint64_t> requests;
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> latency_sum;
+    std::atomic<uint64_t> latency_max;
+    std::atomic<uint64_t> learned;
+    std::atomic<uint64_t> recalls;
+    clock_type::time_point time_start;
+
+    counters() : requests(0), batches(0), latency_sum(0), latency_max(0), learned(0), recalls(0),
+                 time_start(clock_type::now()) {}
+
+    void record(const job& j)
+    {
+        uint64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - j.time_arrival).count();
+        uint64_t current = latency_max.load();
+
+        requests++;
+        latency_sum += latency;
+        while (latency > current && !latency_max.compare_exchange_weak(current, latency));
+    }
+
+    std::vector<uint64_t> snapshot() const
+    {
+        std::vector<uint64_t> vec_stats(SAM_STATS_COUNT);
+
+        vec_stats[SAM_STATS_REQUESTS]       = requests;
+        vec_stats[SAM_STATS_BATCHES]        = batches;
+        vec_stats[SAM_STATS_LATENCY_SUM]    = latency_sum;
+        vec_stats[SAM_STATS_LATENCY_MAX]    = latency_max;
+        vec_stats[SAM_STATS_UPTIME]         = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - time_start).count();
+        vec_stats[SAM_STATS_LEARNED]        = learned;
+        vec_stats[SAM_STATS_RECALLS]        = recalls;
+
+        return vec_stats;
+    }
+};
+
+/**
+ * @brief coalesces the concurrent requests into micro-batches.
+ */
+class batcher
+{
+  public:
+    batcher(sam& memory, counters& stats) : memory(memory), stats(stats), stopped(false) {}
+
+    //! queue a request; the caller waits on the future of 'j.done'.
+    void submit(job* j)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        queue.push_back(j);
+        cv.notify_one();
+    }
+
+    //! ask the batcher to return once the queue is drained.
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopped = true;
+        cv.notify_one();
+    }
+
+    void run();
+
+  private:
+    void execute(std::vector<job*>& vec_batch);
+
+    sam&                    memory;
+    counters&               stats;
+    std::mutex              mtx;
+    std::condition_variable cv;
+    std::deque<job*>        queue;
+    bool                    stopped;
+};
+
+int  serve(void);
+void client(int fd, batcher& batch, counters& stats);
+void usage(const char* progname);
+void on_signal(int);
+
+int main(int argc, char **argv)
+{
+    static struct option long_options[] =
+        {
+            {"socket", required_argument, 0, 's'},
+            {"load", required_argument, 0, 'l'},
+            {"save", required_argument, 0, 'w'},
+            {"nf", required_argument, 0, 'f'},
+            {"nc", required_argument, 0, 'c'},
+            {"batch", required_argument, 0, 'b'},
+            {"window", required_argument, 0, 't'},
+            {"range", required_argument, 0, 'g'},
+            {"help", no_argument, 0, 'h'},
+            {0, 0, 0, 0},
+        };
+
+    const char *const short_opts = "hs:l:w:f:c:b:t:g:";
+
+    while (true)
+    {
+        const auto opt = getopt_long(argc, argv, short_opts, long_options, nullptr);
+
+        if (-1 == opt)
+            break;
+
+        switch (opt)
+        {
+        case 's':
+            socket_path  = optarg;
+            break;
+        case 'l':
+            load_file    = optarg;
+            break;
+        case 'w':
+            save_file    = optarg;
+            break;
+        case 'c':
+            try { nc        = std::stoi(optarg);} catch (...) {/*don't care*/}
+            break;
+        case 'f':
+            try { nf        = std::stoi(optarg);} catch (...) {/*don't care*/}
+            break;
+        case 'b':
+            try { max_batch = std::stoi(optarg);} catch (...) {/*don't care*/}
+            break;
+        case 't':
+            try { window_us = std::stoi(optarg);} catch (...) {/*don't care*/}
+            break;
+        case 'g':
+            if (std::sscanf(optarg, "%zu:%zu", &range_begin, &range_end) != 2 || range_end <= range_begin)
+            {
+                usage(argv[0]);
+                std::cerr << std::endl << "error: the cluster range must be given as begin:end." << std::endl;
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'h': // -h or --help
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        case '?': // unrecognized option
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (load_file != nullptr && !sam::probe(load_file, nc, nf))
+    {
+        std::cerr << "error: failed to read the network file." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (max_batch == 0 || nc == 0 || nf == 0)
+    {
+        usage(argv[0]);
+
+        std::cerr << std::endl << "error: nc, nf and batch must be positive." << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    if (range_end == 0)
+    {
+        range_end = nc;
+    }
+    else if (range_end > nc || (save_file != nullptr && (range_begin != 0 || range_end != nc)))
+    {
+        usage(argv[0]);
+
+        std::cerr << std::endl << "error: the cluster range must lie in [0, nc) and a shard cannot be saved." << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    return serve();
+}
+
+void usage(const char* progname)
+{
+    std::cerr << "Usage : " << progname << "  [options]" << std::endl;
+    USAGE_STDERR << "-h | --help "   << "this help message." << std::endl;
+    USAGE_STDERR << "-s | --socket " << "the Unix domain socket path." << std::endl;
+    USAGE_STDERR << "-l | --load "   << "load the network from a file." << std::endl;
+    USAGE_STDERR << "-w | --save "   << "save the network into a file at shutdown." << std::endl;
+    USAGE_STDERR << "-c | --nc "     << "total number of clusters." << std::endl;
+    USAGE_STDERR << "-f | --nf "     << "number of fanals in each cluster." << std::endl;
+    USAGE_STDERR << "-b | --batch "  << "maximum number of requests in a micro-batch." << std::endl;
+    USAGE_STDERR << "-t | --window " << "micro-batch window in microseconds." << std::endl;
+    USAGE_STDERR << "-g | --range "  << "serve the shard of the target clusters begin:end." << std::endl;
+}
+
+void on_signal(int)
+{
+    running = 0;
+}
+
+static bool read_elements(int fd, std::vector<size_t>& vec_arg, size_t uint_size, size_t uint_limit)
+{
+    std::vector<uint32_t> vec_wire(uint_size);
+
+    if (!read_full(fd, vec_wire.data(), uint_size * sizeof(uint32_t))) return false;
+
+    vec_arg.assign(vec_wire.begin(), vec_wire.end());
+
+    // the elements are validated here so that the network never sees an out of range index.
+    for (size_t uint_indx = 0; uint_indx < uint_size; uint_indx++)
+    {
+        if (vec_arg[uint_indx] >= uint_limit) vec_arg[uint_indx] = SIZE_MAX;
+    }
+
+    return true;
+}
+
+// skips the payload declared by a request that carries none (or that is not served).
+static bool skip_elements(int fd, size_t uint_size)
+{
+    uint32_t buffer[1024];
+
+    while (uint_size > 0)
+    {
+        size_t uint_chunk = std::min(uint_size, sizeof(buffer) / sizeof(uint32_t));
+
+        if (!read_full(fd, buffer, uint_chunk * sizeof(uint32_t))) return false;
+
+        uint_size -= uint_chunk;
+    }
+
+    return true;
+}
+
+// true if no cluster is given twice (a cluster holds one fanal of a message).
+static bool distinct(std::vector<size_t> vec_clusters)
+{
+    std::sort(vec_clusters.begin(), vec_clusters.end());
+
+    return std::adjacent_find(vec_clusters.begin(), vec_clusters.end()) == vec_clusters.end();
+}
+
+void batcher::run()
+{
+    std::vector<job*> vec_batch;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+
+            cv.wait(lock, [this]() { return !queue.empty() || stopped; });
+
+            if (queue.empty()) return;
+
+            // give the concurrent clients a chance to join the micro-batch.
+            clock_type::time_point deadline = queue.front()->time_arrival + std::chrono::microseconds(window_us);
+            cv.wait_until(lock, deadline, [this]() { return queue.size() >= max_batch || stopped; });
+
+            size_t uint_size = std::min(queue.size(), max_batch);
+            vec_batch.assign(queue.begin(), queue.begin() + uint_size);
+            queue.erase(queue.begin(), queue.begin() + uint_size);
+        }
+
+        execute(vec_batch);
+        stats.batches++;
+    }
+}
+
+// The learn requests of a batch are executed in their arrival order by a separate
+// thread while the recall requests are decoded in parallel by the batch recall
+// routines. Each recall works on its own snapshot (see epoch.hpp): it sees the
+// messages learned by the previous batches and may see some of the messages of the
+// learn requests of its batch, each of them either entirely or not at all.
+void batcher::execute(std::vector<job*>& vec_batch)
+{
+    std::vector<std::vector<size_t>> vec_learn;
+    std::vector<job*> vec_learn_jobs;
+    std::vector<job*> vec_blind_jobs;
+    std::map<uint32_t, std::vector<job*>> map_guided_jobs; // grouped by the number of iterations
+
+    for (std::vector<job*>::iterator itj = vec_batch.begin(); itj != vec_batch.end(); itj++)
+    {
+        job* j = *itj;
+
+        switch (j->header.op)
+        {
+        case SAM_OP_LEARN:
+            vec_learn.push_back(j->vec_message);
+            vec_learn_jobs.push_back(j);
+            break;
+        case SAM_OP_RECALL_BLIND:
+            vec_blind_jobs.push_back(j);
+            break;
+        case SAM_OP_RECALL_GUIDED:
+            map_guided_jobs[j->header.nit].push_back(j);
+            break;
+        case SAM_OP_CONTAINS:
+            j->response.status = memory.contains(j->vec_message, j->vec_clusters) ? SAM_STATUS_OK : SAM_STATUS_NOT_FOUND;
+            break;
+        }
+    }
+
+    std::future<std::vector<std::vector<size_t>>> learned;
+
+    if (!vec_learn.empty())
+        learned = std::async(std::launch::async, [this, &vec_learn]() { return memory.learn(vec_learn); });
+
+    std::vector<std::pair<std::vector<job*>*, std::vector<std::vector<std::vector<size_t>>>>> vec_results;
+
+    if (!vec_blind_jobs.empty())
+    {
+        std::vector<std::vector<size_t>> vec_messages, vec_clusters;
+
+        for (std::vector<job*>::iterator itj = vec_blind_jobs.begin(); itj != vec_blind_jobs.end(); itj++)
+        {
+            vec_messages.push_back((*itj)->vec_message);
+            vec_clusters.push_back((*itj)->vec_clusters);
+        }
+
+        vec_results.push_back(std::make_pair(&vec_blind_jobs, memory.recall_blind_batch(vec_messages, vec_clusters)));
+    }
+
+    for (std::map<uint32_t, std::vector<job*>>::iterator itg = map_guided_jobs.begin(); itg != map_guided_jobs.end(); itg++)
+    {
+        std::vector<std::vector<size_t>> vec_messages, vec_clusters, vec_clusters_all;
+
+        for (std::vector<job*>::iterator itj = itg->second.begin(); itj != itg->second.end(); itj++)
+        {
+            vec_messages.push_back((*itj)->vec_message);
+            vec_clusters.push_back((*itj)->vec_clusters);
+            vec_clusters_all.push_back((*itj)->vec_clusters_all);
+        }
+
+        vec_results.push_back(std::make_pair(&itg->second, memory.recall_guided_batch(vec_messages, vec_clusters, vec_clusters_all, itg->first)));
+    }
+
+    for (size_t uint_group = 0; uint_group < vec_results.size(); uint_group++)
+    {
+        std::vector<job*>& vec_jobs = *vec_results[uint_group].first;
+        std::vector<std::vector<std::vector<size_t>>>& vec_retrieved = vec_results[uint_group].second;
+
+        for (size_t uint_indx = 0; uint_indx < vec_jobs.size(); uint_indx++)
+        {
+            std::vector<std::vector<size_t>>& vec_resp = vec_retrieved[uint_indx];
+            size_t uint_count = vec_resp[0].size();
+
+            vec_jobs[uint_indx]->response.status = uint_count > 0 ? SAM_STATUS_OK : SAM_STATUS_NOT_FOUND;
+            vec_jobs[uint_indx]->response.count  = uint_count;
+            vec_jobs[uint_indx]->vec_payload.assign(vec_resp[0].begin(), vec_resp[0].end());
+            vec_jobs[uint_indx]->vec_payload.insert(vec_jobs[uint_indx]->vec_payload.end(), vec_resp[1].begin(), vec_resp[1].end());
+        }
+
+        stats.recalls += vec_jobs.size();
+    }
+
+    if (learned.valid())
+    {
+        std::vector<std::vector<size_t>> vec_clusters = learned.get();
+
+        for (size_t uint_indx = 0; uint_indx < vec_learn_jobs.size(); uint_indx++)
+        {
+            vec_learn_jobs[uint_indx]->vec_payload.assign(vec_clusters[uint_indx].begin(), vec_clusters[uint_indx].end());
+            vec_learn_jobs[uint_indx]->response.count = vec_clusters[uint_indx].size();
+        }
+
+        stats.learned += vec_learn.size();
+    }
+
+    for (std::vector<job*>::iterator itj = vec_batch.begin(); itj != vec_batch.end(); itj++)
+    {
+        stats.record(**itj);
+        (*itj)->done.set_value();
+    }
+}
+
+// This routine serves the requests of a single client until it disconnects.
+void client(int fd, batcher& batch, counters& stats)
+{
+    while (true)
+    {
+        job j;
+
+        if (!read_full(fd, &j.header, sizeof(j.header)) || j.header.magic != SAM_PROTOCOL_MAGIC)
+            break;
+
+        j.time_arrival      = clock_type::now();
+        j.response.magic    = SAM_PROTOCOL_MAGIC;
+        j.response.status   = SAM_STATUS_OK;
+        j.response.id       = j.header.id;
+        j.response.count    = 0;
+
+        // an oversized payload cannot be skipped in a reasonable time: the request is
+        // answered and the connection closed.
+        if (j.header.nknown > SAM_MAX_ELEMENTS || j.header.nall > SAM_MAX_ELEMENTS)
+        {
+            j.response.status = SAM_STATUS_BAD_REQUEST;
+            write_full(fd, &j.response, sizeof(j.response));
+            break;
+        }
+
+        bool bool_valid = true;
+        bool bool_read  = true;
+
+        // elements are in [1, nf] on the wire while clusters are in [0, nc).
+        switch (j.header.op)
+        {
+        case SAM_OP_LEARN:
+            bool_read  = read_elements(fd, j.vec_message, j.header.nknown, nf + 1);
+            bool_valid = j.header.nknown <= nc;
+            break;
+        case SAM_OP_RECALL_GUIDED:
+            bool_read  = read_elements(fd, j.vec_message, j.header.nknown, nf + 1) &&
+                         read_elements(fd, j.vec_clusters, j.header.nknown, nc) &&
+                         read_elements(fd, j.vec_clusters_all, j.header.nall, nc);
+            bool_valid = !exist(j.vec_clusters_all, SIZE_MAX) && distinct(j.vec_clusters_all) &&
+                         j.header.nall > 0 && j.header.nit <= SAM_MAX_ITERATIONS;
+            break;
+        case SAM_OP_RECALL_BLIND:
+        case SAM_OP_CONTAINS:
+            bool_read  = read_elements(fd, j.vec_message, j.header.nknown, nf + 1) &&
+                         read_elements(fd, j.vec_clusters, j.header.nknown, nc);
+            break;
+        case SAM_OP_STATS:
+            bool_read  = skip_elements(fd, (size_t)j.header.nknown + j.header.nall);
+            break;
+        default:
+            bool_read  = skip_elements(fd, (size_t)j.header.nknown + j.header.nall);
+            bool_valid = false;
+        }
+
+        if (!bool_read) break;
+
+        bool_valid = bool_valid && !exist(j.vec_message, SIZE_MAX) && !exist(j.vec_message, 0) &&
+                     !exist(j.vec_clusters, SIZE_MAX) && distinct(j.vec_clusters);
+
+        if (!bool_valid)
+        {
+            j.response.status = SAM_STATUS_BAD_REQUEST;
+        }
+        else if (j.header.op == SAM_OP_STATS)
+        {
+            std::vector<uint64_t> vec_stats = stats.snapshot();
+            j.response.count = vec_stats.size();
+            if (!write_full(fd, &j.response, sizeof(j.response)) ||
+                !write_full(fd, vec_stats.data(), vec_stats.size() * sizeof(uint64_t)))
+                break;
+            continue;
+        }
+        else
+        {
+            std::future<void> done = j.done.get_future();
+            batch.submit(&j);
+            done.wait();
+        }
+
+        if (!write_full(fd, &j.response, sizeof(j.response)) ||
+            !write_full(fd, j.vec_payload.data(), j.vec_payload.size() * sizeof(uint32_t)))
+            break;
+    }
+}
+
+// A connection is served by its own thread. The socket is closed by the daemon once the
+// thread is joined, so that it can be shut down at any time to stop the thread.
+struct connection
+{
+    int fd;
+    std::thread thread;
+    std::shared_ptr<std::atomic<bool>> finished;
+};
+
+// joins and closes the connections whose thread has finished (all of them if 'bool_all').
+static void reap(std::list<connection>& list_connections, bool bool_all)
+{
+    for (std::list<connection>::iterator itc = list_connections.begin(); itc != list_connections.end();)
+    {
+        if (bool_all || itc->finished->load())
+        {
+            itc->thread.join();
+            ::close(itc->fd);
+            itc = list_connections.erase(itc);
+        }
+        else
+        {
+            itc++;
+        }
+    }
+}
+
+int serve(void)
+{
+    std::srand(std::time(nullptr));
+
+    sam  memory(nc, nf, range_begin, range_end);
+    bool bool_shard = range_begin != 0 || range_end != nc;
+
+    if (load_file != nullptr && !memory.load(load_file))
+    {
+        std::cerr << "error: failed to load the network file." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    int fd_listen = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (fd_listen < 0 || std::strlen(socket_path) >= sizeof(addr.sun_path))
+    {
+        std::cerr << "error: failed to create the socket." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::strcpy(addr.sun_path, socket_path);
+    ::unlink(socket_path);
+
+    if (::bind(fd_listen, (struct sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(fd_listen, SOMAXCONN) != 0)
+    {
+        std::cerr << "error: failed to listen on " << socket_path << "." << std::endl;
+        std::cerr << std::strerror(errno) << std::endl;
+        ::close(fd_listen);
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    counters stats;
+    batcher  batch(memory, stats);
+    std::thread thread_batcher(&batcher::run, &batch);
+
+    std::cout << "serving nc=" << nc << " nf=" << nf;
+    if (bool_shard) std::cout << " clusters " << range_begin << ":" << range_end;
+    std::cout << " on " << socket_path << std::endl;
+
+    std::list<connection> list_connections;
+
+    while (running)
+    {
+        reap(list_connections, false);
+
+        struct pollfd pfd = {fd_listen, POLLIN, 0};
+
+        if (::poll(&pfd, 1, 250) <= 0) continue;
+
+        int fd = ::accept(fd_listen, nullptr, nullptr);
+        if (fd < 0) continue;
+
+        connection conn;
+        conn.fd       = fd;
+        conn.finished = std::make_shared<std::atomic<bool>>(false);
+
+        std::shared_ptr<std::atomic<bool>> finished = conn.finished;
+
+        if (bool_shard)
+        {
+            // a shard is driven by a single coordinator that serializes its requests.
+            conn.thread = std::thread([fd, finished, &memory]() { shard_serve(fd, memory); finished->store(true); });
+        }
+        else
+        {
+            conn.thread = std::thread([fd, finished, &batch, &stats]() { client(fd, batch, stats); finished->store(true); });
+        }
+
+        list_connections.push_back(std::move(conn));
+    }
+
+    ::close(fd_listen);
+    ::unlink(socket_path);
+
+    // the connections are stopped before the batcher and the network they use go away.
+    for (std::list<connection>::iterator itc = list_connections.begin(); itc != list_connections.end(); itc++)
+    {
+        ::shutdown(itc->fd, SHUT_RDWR);
+    }
+
+    reap(list_connections, true);
+
+    batch.stop();
+    thread_batcher.join();
+
+    std::vector<uint64_t> vec_stats = stats.snapshot();
+    double double_uptime = vec_stats[SAM_STATS_UPTIME] * 1.0e-9;
+
+    std::cout << std::setprecision(5)
+              << std::setw(CWIDTH) << "requests"  << std::setw(CWIDTH) << "batches"
+              << std::setw(CWIDTH) << "req/s"     << std::setw(CWIDTH) << "mean (us)"
+              << std::setw(CWIDTH) << "max (us)"  << std::endl
+              << std::setw(CWIDTH) << vec_stats[SAM_STATS_REQUESTS]
+              << std::setw(CWIDTH) << vec_stats[SAM_STATS_BATCHES]
+              << std::setw(CWIDTH) << vec_stats[SAM_STATS_REQUESTS] / double_uptime
+              << std::setw(CWIDTH) << (vec_stats[SAM_STATS_REQUESTS] ? vec_stats[SAM_STATS_LATENCY_SUM] * 1.0e-3 / vec_stats[SAM_STATS_REQUESTS] : 0.0)
+              << std::setw(CWIDTH) << vec_stats[SAM_STATS_LATENCY_MAX] * 1.0e-3 << std::endl;
+
+    if (save_file != nullptr && !memory.save(save_file))
+    {
+        std::cerr << "error: failed to save the network file." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
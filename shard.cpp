@@ -0,0 +1,514 @@
+/**
+ * @file shard.cpp
+ * @brief Sparse Associative Memory (SAM) sharded over many processes
+ */
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <stdexcept>
+#include <cstring>
+
+#include "shard.hpp"
+#include "protocol.hpp"
+
+#define SHARD_LEARN_CHUNK   SAM_MAX_ELEMENTS // maximum number of message elements per learn request
+
+void shard_serve(int fd, sam& memory)
+{
+    size_t nc = memory.clusters();
+    size_t nf = memory.fanals();
+
+    // The activities are only kept for the owned clusters; the other rows stay empty.
+    // They live in the scratch arena of the thread for the lifetime of the connection.
+    scratch_scope scope;
+    scratch_matrix vec_network(nc);
+    std::vector<uint32_t> vec_wire, vec_payload;
+
+    for (size_t uint_cluster = memory.begin(); uint_cluster < memory.end(); uint_cluster++)
+    {
+        vec_network[uint_cluster].resize(nf);
+    }
+
+    while (true)
+    {
+        sam_request_header header;
+
+        if (!read_full(fd, &header, sizeof(header)) || header.magic != SAM_PROTOCOL_MAGIC)
+            break;
+
+        sam_response_header response = {SAM_PROTOCOL_MAGIC, SAM_STATUS_OK, header.id, 0};
+        size_t uint_wire = 0;
+        bool bool_oversized = false;
+
+        vec_payload.clear();
+
+        switch (header.op)
+        {
+        case SAM_OP_SHARD_LEARN:
+            bool_oversized = header.nknown > SHARD_LEARN_CHUNK || header.nall > header.nknown;
+            uint_wire = header.nall + 2 * (size_t)header.nknown;
+            break;
+        case SAM_OP_SHARD_SCORE:
+            bool_oversized = header.nknown > nc * nf || header.nall > nc;
+            uint_wire = 2 * (size_t)header.nknown + header.nall;
+            break;
+        }
+
+        // the payload is not read: the request is rejected and the connection closed.
+        if (bool_oversized)
+        {
+            response.status = SAM_STATUS_BAD_REQUEST;
+            write_full(fd, &response, sizeof(response));
+            break;
+        }
+
+        vec_wire.resize(uint_wire);
+        if (!read_full(fd, vec_wire.data(), uint_wire * sizeof(uint32_t))) break;
+
+        switch (header.op)
+        {
+        case SAM_OP_SHARD_INFO:
+            vec_payload.push_back(nc);
+            vec_payload.push_back(nf);
+            vec_payload.push_back(memory.begin());
+            vec_payload.push_back(memory.end());
+            break;
+
+        case SAM_OP_SHARD_RESET:
+            memory.reset();
+            break;
+
+        case SAM_OP_SHARD_LEARN:
+        {
+            std::vector<std::vector<size_t>> vec_messages(header.nall), vec_clusters(header.nall);
+            const uint32_t* ptr_elements = vec_wire.data() + header.nall;
+            const uint32_t* ptr_clusters = ptr_elements + header.nknown;
+            size_t uint_offset = 0;
+
+            for (size_t uint_msg_indx = 0; uint_msg_indx < header.nall && response.status == SAM_STATUS_OK; uint_msg_indx++)
+            {
+                size_t uint_length = vec_wire[uint_msg_indx];
+
+                if (uint_offset + uint_length > header.nknown)
+                {
+                    response.status = SAM_STATUS_BAD_REQUEST;
+                    break;
+                }
+
+                for (size_t uint_indx = uint_offset; uint_indx < uint_offset + uint_length; uint_indx++)
+                {
+                    if (ptr_elements[uint_indx] == 0 || ptr_elements[uint_indx] > nf || ptr_clusters[uint_indx] >= nc)
+                        response.status = SAM_STATUS_BAD_REQUEST;
+                }
+
+                vec_messages[uint_msg_indx].assign(ptr_elements + uint_offset, ptr_elements + uint_offset + uint_length);
+                vec_clusters[uint_msg_indx].assign(ptr_clusters + uint_offset, ptr_clusters + uint_offset + uint_length);
+                uint_offset += uint_length;
+            }
+
+            if (response.status == SAM_STATUS_OK)
+                memory.learn(vec_messages, vec_clusters);
+
+            break;
+        }
+
+        case SAM_OP_SHARD_SCORE:
+        {
+            scratch_scope scope_request;
+            scratch_matrix vec_network_list(nc, scratch_vector(0));
+            scratch_vector vec_clusters_lag;
+            std::vector<size_t> vec_targets(vec_wire.begin() + 2 * header.nknown, vec_wire.end());
+
+            for (size_t uint_indx = 0; uint_indx < header.nknown; uint_indx++)
+            {
+                size_t uint_cluster = vec_wire[uint_indx];
+                size_t uint_element = vec_wire[header.nknown + uint_indx];
+
+                if (uint_cluster >= nc || uint_element == 0 || uint_element > nf)
+                {
+                    response.status = SAM_STATUS_BAD_REQUEST;
+                    break;
+                }
+
+                if (vec_network_list[uint_cluster].empty())
+                    vec_clusters_lag.push_back(uint_cluster);
+
+                vec_network_list[uint_cluster].push_back(uint_element);
+            }
+
+            for (size_t uint_indx = 0; uint_indx < vec_targets.size(); uint_indx++)
+            {
+                if (vec_targets[uint_indx] < memory.begin() || vec_targets[uint_indx] >= memory.end())
+                    response.status = SAM_STATUS_BAD_REQUEST;
+            }
+
+            if (response.status != SAM_STATUS_OK)
+                break;
+
+            // the activity of a fanal starts with one if the fanal is active.
+            for (std::vector<size_t>::iterator itc = vec_targets.begin(); itc != vec_targets.end(); itc++)
+            {
+                std::fill(vec_network[*itc].begin(), vec_network[*itc].end(), 0);
+
+                for (scratch_vector::iterator itf = vec_network_list[*itc].begin(); itf != vec_network_list[*itc].end(); itf++)
+                {
+                    vec_network[*itc][*itf - 1] = 1;
+                }
+            }
+
+            memory.score(vec_targets, vec_clusters_lag, vec_network_list, vec_network, true);
+
+            // Only the fanals with the maximum activity of each cluster are sent back
+            // since the others can never win the global winner-take-all.
+            for (std::vector<size_t>::iterator itc = vec_targets.begin(); itc != vec_targets.end(); itc++)
+            {
+                size_t uint_max_value = max(vec_network[*itc]);
+                size_t uint_count_pos = vec_payload.size() + 2;
+
+                vec_payload.push_back(*itc);
+                vec_payload.push_back(uint_max_value);
+                vec_payload.push_back(0);
+
+                for (size_t uint_indx = 0; uint_indx < nf; uint_indx++)
+                {
+                    if (vec_network[*itc][uint_indx] == uint_max_value)
+                        vec_payload.push_back(uint_indx + 1);
+                }
+
+                vec_payload[uint_count_pos] = vec_payload.size() - uint_count_pos - 1;
+            }
+
+            break;
+        }
+
+        default:
+            response.status = SAM_STATUS_BAD_REQUEST;
+        }
+
+        response.count = vec_payload.size();
+
+        if (!write_full(fd, &response, sizeof(response)) ||
+            !write_full(fd, vec_payload.data(), vec_payload.size() * sizeof(uint32_t)))
+            break;
+    }
+}
+
+sam_sharded::sam_sharded(size_t nc, size_t nf, size_t nshards)
+{
+    nclusters = nc;
+    nfanals   = nf;
+    nshards   = std::max(std::min(nshards, nclusters), (size_t)1);
+
+    for (size_t uint_shard = 0; uint_shard < nshards; uint_shard++)
+    {
+        size_t uint_begin = uint_shard * nclusters / nshards;
+        size_t uint_end   = (uint_shard + 1) * nclusters / nshards;
+        int fds[2];
+
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+            throw std::runtime_error("failed to create the shard socket pair.");
+
+        pid_t pid = ::fork();
+
+        if (pid < 0)
+            throw std::runtime_error("failed to start the shard process.");
+
+        if (pid == 0)
+        {
+            // The shard process only keeps its own end of the connection. It never returns
+            // into the code of the parent, even when it fails.
+            try
+            {
+                ::close(fds[0]);
+                for (std::vector<int>::iterator itd = vec_fds.begin(); itd != vec_fds.end(); itd++) ::close(*itd);
+
+                sam memory(nclusters, nfanals, uint_begin, uint_end);
+                shard_serve(fds[1], memory);
+            }
+            catch (...)
+            {
+                ::_exit(EXIT_FAILURE);
+            }
+
+            ::_exit(EXIT_SUCCESS);
+        }
+
+        ::close(fds[1]);
+
+        vec_fds.push_back(fds[0]);
+        vec_pids.push_back(pid);
+        vec_begin.push_back(uint_begin);
+        vec_end.push_back(uint_end);
+    }
+}
+
+sam_sharded::sam_sharded(const std::vector<std::string>& vec_paths)
+{
+    nclusters = 0;
+    nfanals   = 0;
+
+    for (size_t uint_shard = 0; uint_shard < vec_paths.size(); uint_shard++)
+    {
+        struct sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, vec_paths[uint_shard].c_str(), sizeof(addr.sun_path) - 1);
+
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (fd < 0 || ::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+        {
+            if (fd >= 0) ::close(fd);
+            throw std::runtime_error("failed to connect to the shard " + vec_paths[uint_shard] + ".");
+        }
+
+        vec_fds.push_back(fd);
+
+        std::vector<uint32_t> vec_info;
+        request(uint_shard, SAM_OP_SHARD_INFO, 0, 0, std::vector<uint32_t>(0));
+        response(uint_shard, vec_info);
+
+        if (vec_info.size() != 4)
+            throw std::runtime_error("invalid shard " + vec_paths[uint_shard] + ".");
+
+        if (uint_shard == 0)
+        {
+            nclusters = vec_info[0];
+            nfanals   = vec_info[1];
+        }
+
+        if (vec_info[0] != nclusters || vec_info[1] != nfanals)
+            throw std::runtime_error("the network parameters of the shards differ.");
+
+        vec_begin.push_back(vec_info[2]);
+        vec_end.push_back(vec_info[3]);
+    }
+
+    // The shards must cover all the clusters exactly once.
+    std::vector<size_t> vec_owner(nclusters, SIZE_MAX);
+
+    for (size_t uint_shard = 0; uint_shard < vec_fds.size(); uint_shard++)
+    {
+        for (size_t uint_cluster = vec_begin[uint_shard]; uint_cluster < vec_end[uint_shard]; uint_cluster++)
+        {
+            if (vec_owner[uint_cluster] != SIZE_MAX)
+                throw std::runtime_error("the cluster ranges of the shards overlap.");
+            vec_owner[uint_cluster] = uint_shard;
+        }
+    }
+
+    if (nclusters == 0 || exist(vec_owner, SIZE_MAX))
+        throw std::runtime_error("the shards do not cover all the clusters.");
+}
+
+sam_sharded::~sam_sharded()
+{
+    for (std::vector<int>::iterator itd = vec_fds.begin(); itd != vec_fds.end(); itd++)
+    {
+        ::close(*itd);
+    }
+
+    // A local shard exits once its connection is closed.
+    for (std::vector<pid_t>::iterator itp = vec_pids.begin(); itp != vec_pids.end(); itp++)
+    {
+        ::waitpid(*itp, nullptr, 0);
+    }
+}
+
+void sam_sharded::request(size_t uint_shard, uint32_t op, uint32_t nknown, uint32_t nall,
+                          const std::vector<uint32_t>& vec_payload)
+{
+    sam_request_header header = {SAM_PROTOCOL_MAGIC, op, (uint32_t)uint_shard, nknown, nall, 0};
+
+    if (!write_full(vec_fds[uint_shard], &header, sizeof(header)) ||
+        !write_full(vec_fds[uint_shard], vec_payload.data(), vec_payload.size() * sizeof(uint32_t)))
+        throw std::runtime_error("lost the connection to a shard.");
+}
+
+void sam_sharded::response(size_t uint_shard, std::vector<uint32_t>& vec_payload)
+{
+    sam_response_header header;
+
+    if (!read_full(vec_fds[uint_shard], &header, sizeof(header)) || header.magic != SAM_PROTOCOL_MAGIC)
+        throw std::runtime_error("lost the connection to a shard.");
+
+    vec_payload.resize(header.count);
+
+    if (!read_full(vec_fds[uint_shard], vec_payload.data(), header.count * sizeof(uint32_t)))
+        throw std::runtime_error("lost the connection to a shard.");
+
+    if (header.status != SAM_STATUS_OK)
+        throw std::runtime_error("a shard rejected the request.");
+}
+
+void sam_sharded::reset()
+{
+    std::vector<uint32_t> vec_payload;
+
+    for (size_t uint_shard = 0; uint_shard < vec_fds.size(); uint_shard++)
+        request(uint_shard, SAM_OP_SHARD_RESET, 0, 0, vec_payload);
+
+    for (size_t uint_shard = 0; uint_shard < vec_fds.size(); uint_shard++)
+        response(uint_shard, vec_payload);
+}
+
+// The messages are sent to all the shards in chunks; each shard only stores
+// the connections towards the clusters it owns.
+std::vector<std::vector<size_t>> sam_sharded::learn(const std::vector<std::vector<size_t>>& vec_message)
+{
+    std::vector<std::vector<size_t>> vec_random_clusters = random_clusters(vec_message, nclusters);
+    std::vector<uint32_t> vec_lengths, vec_elements, vec_clusters, vec_payload;
+
+    size_t uint_num_messages = vec_message.size();
+
+    for (size_t uint_msg_indx = 0; uint_msg_indx < uint_num_messages; uint_msg_indx++)
+    {
+        vec_lengths.push_back(vec_message[uint_msg_indx].size());
+        vec_elements.insert(vec_elements.end(), vec_message[uint_msg_indx].begin(), vec_message[uint_msg_indx].end());
+        vec_clusters.insert(vec_clusters.end(), vec_random_clusters[uint_msg_indx].begin(), vec_random_clusters[uint_msg_indx].end());
+
+        bool bool_last = uint_msg_indx + 1 == uint_num_messages;
+
+        if (!bool_last && vec_elements.size() + vec_message[uint_msg_indx + 1].size() <= SHARD_LEARN_CHUNK)
+            continue;
+
+        if (vec_elements.size() > SHARD_LEARN_CHUNK)
+            throw std::runtime_error("the message is too long.");
+
+        vec_payload = vec_lengths;
+        vec_payload.insert(vec_payload.end(), vec_elements.begin(), vec_elements.end());
+        vec_payload.insert(vec_payload.end(), vec_clusters.begin(), vec_clusters.end());
+
+        for (size_t uint_shard = 0; uint_shard < vec_fds.size(); uint_shard++)
+            request(uint_shard, SAM_OP_SHARD_LEARN, vec_elements.size(), vec_lengths.size(), vec_payload);
+
+        for (size_t uint_shard = 0; uint_shard < vec_fds.size(); uint_shard++)
+            response(uint_shard, vec_payload);
+
+        vec_lengths.clear();
+        vec_elements.clear();
+        vec_clusters.clear();
+    }
+
+    return vec_random_clusters;
+}
+
+// This routine scatters the active fanals to the shards that own at least one
+// target cluster and gathers the winning fanals of each target cluster.
+void sam_sharded::score(const std::vector<size_t>& vec_targets,
+                        const scratch_vector& vec_clusters_lag,
+                        const scratch_matrix& vec_network_list,
+                        scratch_matrix& vec_network)
+{
+    std::vector<uint32_t> vec_active_clusters, vec_active_elements;
+
+    for (scratch_vector::const_iterator itc = vec_clusters_lag.begin(); itc != vec_clusters_lag.end(); itc++)
+    {
+        for (scratch_vector::const_iterator itf = vec_network_list[*itc].begin(); itf != vec_network_list[*itc].end(); itf++)
+        {
+            vec_active_clusters.push_back(*itc);
+            vec_active_elements.push_back(*itf);
+        }
+    }
+
+    std::vector<bool> vec_involved(vec_fds.size(), false);
+    std::vector<uint32_t> vec_payload;
+
+    for (size_t uint_shard = 0; uint_shard < vec_fds.size(); uint_shard++)
+    {
+        vec_payload = vec_active_clusters;
+        vec_payload.insert(vec_payload.end(), vec_active_elements.begin(), vec_active_elements.end());
+
+        for (std::vector<size_t>::const_iterator itc = vec_targets.begin(); itc != vec_targets.end(); itc++)
+        {
+            if (*itc >= vec_begin[uint_shard] && *itc < vec_end[uint_shard])
+                vec_payload.push_back(*itc);
+        }
+
+        size_t uint_num_targets = vec_payload.size() - 2 * vec_active_clusters.size();
+
+        if (uint_num_targets == 0) continue;
+
+        request(uint_shard, SAM_OP_SHARD_SCORE, vec_active_clusters.size(), uint_num_targets, vec_payload);
+        vec_involved[uint_shard] = true;
+    }
+
+    for (std::vector<size_t>::const_iterator itc = vec_targets.begin(); itc != vec_targets.end(); itc++)
+    {
+        std::fill(vec_network[*itc].begin(), vec_network[*itc].end(), 0);
+    }
+
+    for (size_t uint_shard = 0; uint_shard < vec_fds.size(); uint_shard++)
+    {
+        if (!vec_involved[uint_shard]) continue;
+
+        response(uint_shard, vec_payload);
+
+        size_t uint_indx = 0;
+        while (uint_indx + 3 <= vec_payload.size())
+        {
+            size_t uint_cluster   = vec_payload[uint_indx];
+            size_t uint_max_value = vec_payload[uint_indx + 1];
+            size_t uint_count     = vec_payload[uint_indx + 2];
+
+            if (uint_cluster >= nclusters || uint_indx + 3 + uint_count > vec_payload.size())
+                throw std::runtime_error("invalid shard response.");
+
+            for (size_t uint_fanal = 0; uint_fanal < uint_count; uint_fanal++)
+            {
+                size_t uint_element = vec_payload[uint_indx + 3 + uint_fanal];
+                if (uint_element == 0 || uint_element > nfanals)
+                    throw std::runtime_error("invalid shard response.");
+                vec_network[uint_cluster][uint_element - 1] = uint_max_value;
+            }
+
+            uint_indx += 3 + uint_count;
+        }
+    }
+}
+
+std::vector<std::vector<size_t>> sam_sharded::recall_blind(const std::vector<size_t>& vec_message, const std::vector<size_t>& vec_clusters)
+{
+    using namespace std::placeholders;
+
+    return sam::decode_blind(nclusters, nfanals, vec_message, vec_clusters,
+                             std::bind(&sam_sharded::score, this, _1, _2, _3, _4));
+}
+
+std::vector<std::vector<size_t>> sam_sharded::recall_guided(const std::vector<size_t>& vec_message,
+                                                            const std::vector<size_t>& vec_clusters,
+                                                            const std::vector<size_t>& vec_clusters_all,
+                                                            size_t uint_max_it)
+{
+    using namespace std::placeholders;
+
+    return sam::decode_guided(nclusters, nfanals, vec_message, vec_clusters, vec_clusters_all, uint_max_it,
+                              std::bind(&sam_sharded::score, this, _1, _2, _3, _4));
+}
+
+bool sam_sharded::recall_blind(const std::vector<size_t>& vec_message,
+                               const std::vector<size_t>& vec_clusters,
+                               const cluster_slots& slots,
+                               size_t* ptr_retrieved)
+{
+    using namespace std::placeholders;
+
+    return sam::decode_blind(nclusters, nfanals, vec_message, vec_clusters,
+                             std::bind(&sam_sharded::score, this, _1, _2, _3, _4), slots, ptr_retrieved);
+}
+
+bool sam_sharded::recall_guided(const std::vector<size_t>& vec_message,
+                                const std::vector<size_t>& vec_clusters,
+                                const std::vector<size_t>& vec_clusters_all,
+                                size_t uint_max_it,
+                                const cluster_slots& slots,
+                                size_t* ptr_retrieved)
+{
+    using namespace std::placeholders;
+
+    return sam::decode_guided(nclusters, nfanals, vec_message, vec_clusters, vec_clusters_all, uint_max_it,
+                              std::bind(&sam_sharded::score, this, _1, _2, _3, _4), slots, ptr_retrieved);
+}
@@ -0,0 +1,121 @@
+/**
+ * @file shard.hpp
+ * @brief Sparse Associative Memory (SAM) sharded over many processes
+ *
+ * The weight tensor of a network is split into contiguous ranges of
+ * target clusters, one range per shard. Each shard is a process that owns
+ * its rows of the weight tensor and scores the fanals of its clusters.
+ * The coordinator scatters the active fanals of each decoding step to the
+ * shards, gathers the maximum activity of each cluster along with its
+ * winning fanals and performs the global winner-take-all.
+ * The network size is therefore bounded by the memory of all the shards
+ * rather than by the memory of a single process.
+ */
+#ifndef __SHARD_HPP__
+#define __SHARD_HPP__
+
+#include <string>
+#include <sys/types.h>
+
+#include "sam.hpp"
+
+/**
+ * @brief serves the shard requests (SAM_OP_SHARD_*) of a coordinator on a connection.
+ * @param fd the connected socket.
+ * @param memory the network shard.
+ *
+ * It returns when the coordinator closes the connection.
+ */
+void shard_serve(int fd, sam& memory);
+
+/**
+ * @class sam_sharded
+ *
+ * @brief coordinator of a network whose target clusters are spread over shards
+ *
+ * The class has the same learn and recall interface as the sam class.
+ */
+class sam_sharded
+{
+
+  public:
+   /**
+    * @brief constructor that starts local shard processes
+    * @param nc the total number of clusters in the network.
+    * @param nf the total number of fanals in each cluster.
+    * @param nshards the number of shards (processes).
+    *
+    * The shards are forked from the calling process and connected to it by socket pairs.
+    */
+    sam_sharded(size_t nc, size_t nf, size_t nshards);
+
+   /**
+    * @brief constructor that connects to running shards
+    * @param vec_paths the Unix domain socket paths of the shards (see sam-serve --range).
+    *
+    * The shards must share the same network parameters and cover all the clusters.
+    */
+    sam_sharded(const std::vector<std::string>& vec_paths);
+
+    //! destructor (stops the local shards)
+    ~sam_sharded();
+
+    //! see sam::learn
+    std::vector<std::vector<size_t>> learn(const std::vector<std::vector<size_t>>& vec_message);
+
+    //! see sam::recall_blind
+    std::vector<std::vector<size_t>> recall_blind(const std::vector<size_t>& vec_message, const std::vector<size_t>& vec_clusters);
+
+    //! see sam::recall_guided
+    std::vector<std::vector<size_t>> recall_guided(const std::vector<size_t>& vec_message,
+                                                   const std::vector<size_t>& vec_clusters,
+                                                   const std::vector<size_t>& vec_clusters_all,
+                                                   size_t uint_max_it);
+
+    //! see sam::recall_blind
+    bool recall_blind(const std::vector<size_t>& vec_message,
+                      const std::vector<size_t>& vec_clusters,
+                      const cluster_slots& slots,
+                      size_t* ptr_retrieved);
+
+    //! see sam::recall_guided
+    bool recall_guided(const std::vector<size_t>& vec_message,
+                       const std::vector<size_t>& vec_clusters,
+                       const std::vector<size_t>& vec_clusters_all,
+                       size_t uint_max_it,
+                       const cluster_slots& slots,
+                       size_t* ptr_retrieved);
+
+    //! see sam::reset
+    void reset();
+
+    //! the total number of clusters in the network.
+    size_t clusters() const { return nclusters; }
+
+    //! the number of fanals in each cluster.
+    size_t fanals() const { return nfanals; }
+
+  private:
+    // the scoring step of the decoders (see sam::scorer).
+    void score(const std::vector<size_t>& vec_targets,
+               const scratch_vector& vec_clusters_lag,
+               const scratch_matrix& vec_network_list,
+               scratch_matrix& vec_network);
+
+    // sends a request to a shard.
+    void request(size_t uint_shard, uint32_t op, uint32_t nknown, uint32_t nall,
+                 const std::vector<uint32_t>& vec_payload);
+
+    // receives the response of a shard.
+    void response(size_t uint_shard, std::vector<uint32_t>& vec_payload);
+
+    std::vector<int>    vec_fds;    // the connections to the shards
+    std::vector<pid_t>  vec_pids;   // the local shard processes
+    std::vector<size_t> vec_begin;  // the first target cluster of each shard
+    std::vector<size_t> vec_end;    // one past the last target cluster of each shard
+
+    size_t nclusters; // The total number of clusters in the network
+    size_t nfanals;   // The number of fanals in each cluster
+};
+
+#endif
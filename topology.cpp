@@ -0,0 +1,133 @@
+/**
+ * @file topology.cpp
+ * @brief NUMA topology helpers
+ */
+
+#include <sys/mman.h>
+#include <sched.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "topology.hpp"
+
+#ifdef SAM_NUMA
+#include <numa.h>
+
+static bool numa_enabled()
+{
+    static const bool enabled = numa_available() >= 0;
+    return enabled;
+}
+#endif
+
+size_t topology_nodes()
+{
+#ifdef SAM_NUMA
+    if (numa_enabled())
+    {
+        int nodes = numa_num_configured_nodes();
+        return nodes > 0 ? nodes : 1;
+    }
+#endif
+    return 1;
+}
+
+size_t topology_node()
+{
+#ifdef SAM_NUMA
+    if (numa_enabled())
+    {
+        int cpu = sched_getcpu();
+        int node = cpu < 0 ? -1 : numa_node_of_cpu(cpu);
+        return node < 0 ? 0 : node;
+    }
+#endif
+    return 0;
+}
+
+static std::atomic<size_t> huge_reserved(0);
+static std::atomic<size_t> huge_transparent(0);
+
+// the size of the mapping that backs 'size' bytes.
+static size_t mapped_size(size_t size)
+{
+    if (size < TOPOLOGY_HUGE_PAGE) return size;
+    return (size + TOPOLOGY_HUGE_PAGE - 1) / TOPOLOGY_HUGE_PAGE * TOPOLOGY_HUGE_PAGE;
+}
+
+// The memory is mapped rather than taken from the heap so that its pages are
+// bound to the node (or first touched by the thread that writes them).
+// A large mapping is rounded up to huge pages and aligned to a huge page so
+// that the transparent huge pages can back all of it.
+void* topology_alloc(size_t size, size_t node)
+{
+    if (size == 0) return nullptr;
+
+    size_t size_mapped = mapped_size(size);
+    void*  ptr         = MAP_FAILED;
+
+    if (size >= TOPOLOGY_HUGE_PAGE)
+    {
+        ptr = mmap(nullptr, size_mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if (ptr != MAP_FAILED)
+        {
+            huge_reserved += size_mapped;
+        }
+        else
+        {
+            char* ptr_over = (char*)mmap(nullptr, size_mapped + TOPOLOGY_HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr_over == MAP_FAILED) return nullptr;
+
+            // the head and the tail beyond the aligned range are given back.
+            char*  ptr_aligned = (char*)(((uintptr_t)ptr_over + TOPOLOGY_HUGE_PAGE - 1) & ~(uintptr_t)(TOPOLOGY_HUGE_PAGE - 1));
+            size_t size_head   = ptr_aligned - ptr_over;
+
+            if (size_head > 0) munmap(ptr_over, size_head);
+            munmap(ptr_aligned + size_mapped, TOPOLOGY_HUGE_PAGE - size_head);
+
+            ptr = ptr_aligned;
+
+#ifdef MADV_HUGEPAGE
+            if (madvise(ptr, size_mapped, MADV_HUGEPAGE) == 0) huge_transparent += size_mapped;
+#endif
+        }
+    }
+    else
+    {
+        ptr = mmap(nullptr, size_mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) return nullptr;
+    }
+
+#ifdef SAM_NUMA
+    if (numa_enabled())
+        numa_tonode_memory(ptr, size_mapped, node);
+#endif
+    (void)node;
+
+    return ptr;
+}
+
+void topology_free(void* ptr, size_t size)
+{
+    if (ptr == nullptr) return;
+
+    munmap(ptr, mapped_size(size));
+}
+
+void topology_huge(size_t& reserved, size_t& transparent)
+{
+    reserved    = huge_reserved;
+    transparent = huge_transparent;
+}
+
+bool topology_pin(size_t node)
+{
+#ifdef SAM_NUMA
+    if (numa_enabled() && topology_nodes() > 1)
+        return numa_run_on_node(node) == 0;
+#endif
+    (void)node;
+    return false;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file topology.hpp
+ * @brief NUMA topology helpers
+ *
+ * The helpers place memory on and pin threads to NUMA nodes through libnuma
+ * when the code is built with SAM_NUMA (see the Makefile) and libnuma reports
+ * a NUMA system at run time. Otherwise the machine is seen as a single node,
+ * the memory comes from anonymous mappings and pinning is a no-op.
+ *
+ * The memory of at least TOPOLOGY_HUGE_PAGE bytes is backed by huge pages to
+ * cut the TLB misses of random probes: reserved huge pages (MAP_HUGETLB) when
+ * the system has some, transparent huge pages (madvise) otherwise.
+ */
+#ifndef __TOPOLOGY_HPP__
+#define __TOPOLOGY_HPP__
+
+#include <cstdlib>
+
+#define TOPOLOGY_HUGE_PAGE  (2 << 20)   // the size of a huge page
+#define TOPOLOGY_ALIGNMENT  64          // the size of a cache line
+
+/**
+ * @brief the number of NUMA nodes (one if NUMA is not supported).
+ */
+size_t topology_nodes();
+
+/**
+ * @brief the NUMA node of the CPU the calling thread runs on.
+ */
+size_t topology_node();
+
+/**
+ * @brief allocates zero-initialized memory on a NUMA node.
+ * @return the memory (aligned to a huge page from TOPOLOGY_HUGE_PAGE bytes on,
+ * to a page otherwise) or nullptr on failure.
+ */
+void* topology_alloc(size_t size, size_t node);
+
+/**
+ * @brief releases memory obtained from topology_alloc.
+ */
+void topology_free(void* ptr, size_t size);
+
+/**
+ * @brief the number of bytes allocated by topology_alloc on reserved huge pages
+ * and on transparent huge page candidates.
+ */
+void topology_huge(size_t& reserved, size_t& transparent);
+
+/**
+ * @brief restricts the calling thread to the CPUs of a NUMA node.
+ * @return true if the thread has been pinned.
+ */
+bool topology_pin(size_t node);
+
+#endif
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <stdexcept>
+
 #include "utility.hpp"
 
 size_t randint(size_t uint_max)
@@ -5,13 +8,13 @@ size_t randint(size_t uint_max)
     return ((size_t)std::rand() % uint_max + 1);
 }
 
-std::vector<size_t> max_indices(const std::vector<size_t>& vec_arg)
+template <typename A> std::vector<size_t, A> max_indices(const std::vector<size_t, A>& vec_arg)
 {
 
     size_t uint_vec_size = vec_arg.size();
-    if (uint_vec_size == 0) return std::vector<size_t>(0);
+    if (uint_vec_size == 0) return std::vector<size_t, A>(0);
     size_t uint_max_value = vec_arg[0];
-    std::vector<size_t> vec_indices(0);
+    std::vector<size_t, A> vec_indices(0);
 
     // find the maximum
     for (size_t uint_indx = 1; uint_indx < uint_vec_size; uint_indx++)
@@ -30,7 +33,7 @@ std::vector<size_t> max_indices(const std::vector<size_t>& vec_arg)
     return vec_indices;
 }
 
-size_t max(const std::vector<size_t>& vec_arg)
+template <typename A> size_t max(const std::vector<size_t, A>& vec_arg)
 {
     size_t uint_max_value = vec_arg[0];
     size_t uint_vec_size = vec_arg.size();
@@ -46,7 +49,7 @@ size_t max(const std::vector<size_t>& vec_arg)
     return uint_max_value;
 }
 
-bool exist(const std::vector<size_t>& vec_arg, size_t uint_arg)
+template <typename A> bool exist(const std::vector<size_t, A>& vec_arg, size_t uint_arg)
 {
     size_t uint_size = vec_arg.size();
 
@@ -59,6 +62,13 @@ bool exist(const std::vector<size_t>& vec_arg, size_t uint_arg)
     return false;
 }
 
+template std::vector<size_t> max_indices(const std::vector<size_t>&);
+template scratch_vector max_indices(const scratch_vector&);
+template size_t max(const std::vector<size_t>&);
+template size_t max(const scratch_vector&);
+template bool exist(const std::vector<size_t>&, size_t);
+template bool exist(const scratch_vector&, size_t);
+
 size_t find_index(const std::vector<size_t>& vec_arg, size_t uint_arg)
 {
     size_t uint_size = vec_arg.size();
@@ -72,6 +82,32 @@ size_t find_index(const std::vector<size_t>& vec_arg, size_t uint_arg)
     return SIZE_MAX;
 }
 
+std::vector<std::vector<size_t>> random_clusters(const std::vector<std::vector<size_t>>& vec_message, size_t uint_num_clusters)
+{
+    size_t uint_num_messages                = vec_message.size();
+    size_t uint_num_msg_clusters            = 0;
+    size_t uint_random_cluster_counter      = 0;
+    size_t uint_randint                     = 0;
+
+    std::vector<std::vector<size_t>> vec_random_clusters(uint_num_messages, std::vector<size_t>(0));
+    for (size_t uint_msg_indx = 0; uint_msg_indx < uint_num_messages; uint_msg_indx++)
+    {
+        uint_num_msg_clusters = vec_message[uint_msg_indx].size();
+        while (uint_random_cluster_counter < uint_num_msg_clusters)
+        {
+            uint_randint = randint(uint_num_clusters) - 1;
+            if (!exist(vec_random_clusters[uint_msg_indx], uint_randint))
+            {
+                vec_random_clusters[uint_msg_indx].push_back(uint_randint);
+                uint_random_cluster_counter++;
+            }
+        }
+        uint_random_cluster_counter = 0;
+    }
+
+    return vec_random_clusters;
+}
+
 std::vector<std::vector<size_t>> sort_clusters(const std::vector<std::vector<size_t>>& vec_message, const std::vector<size_t>& vec_clusters)
 {
     size_t uint_size = vec_clusters.size();
@@ -105,3 +141,70 @@ std::vector<std::vector<size_t>> sort_clusters(const std::vector<std::vector<siz
 
     return vec_return;
 }
+
+// Only the slots of the previous order are cleared, so the table is never scanned.
+void cluster_slots::assign(const std::vector<size_t>& vec_clusters)
+{
+    for (size_t uint_slot = 0; uint_slot < vec_order.size(); uint_slot++)
+    {
+        vec_slots[vec_order[uint_slot]] = SIZE_MAX;
+    }
+
+    vec_order.clear();
+
+    for (size_t uint_slot = 0; uint_slot < vec_clusters.size(); uint_slot++)
+    {
+        if (vec_clusters[uint_slot] >= vec_slots.size() || vec_slots[vec_clusters[uint_slot]] != SIZE_MAX)
+        {
+            assign(std::vector<size_t>());
+            throw std::invalid_argument("the order holds a cluster out of range or twice");
+        }
+
+        vec_slots[vec_clusters[uint_slot]] = uint_slot;
+        vec_order.push_back(vec_clusters[uint_slot]);
+    }
+}
+
+bool cluster_slots::align(const std::vector<std::vector<size_t>>& vec_message, size_t* ptr_aligned) const
+{
+    std::fill(ptr_aligned, ptr_aligned + vec_order.size(), 0);
+
+    if (vec_message.size() < 2) return true;
+
+    for (size_t uint_indx = 0; uint_indx < vec_message[1].size(); uint_indx++)
+    {
+        size_t uint_slot = slot(vec_message[1][uint_indx]);
+
+        if (uint_slot == SIZE_MAX)
+        {
+            std::fill(ptr_aligned, ptr_aligned + vec_order.size(), SIZE_MAX);
+            return false;
+        }
+
+        ptr_aligned[uint_slot] = vec_message[0][uint_indx];
+    }
+
+    return true;
+}
+
+size_t compare_messages(const std::vector<size_t>& vec_offsets,
+                        const size_t* ptr_aligned,
+                        const size_t* ptr_expected,
+                        std::vector<bool>& vec_errors)
+{
+    size_t uint_num_messages = vec_offsets.empty() ? 0 : vec_offsets.size() - 1;
+    size_t uint_num_errors   = 0;
+
+    vec_errors.assign(uint_num_messages, false);
+
+    for (size_t uint_msg_indx = 0; uint_msg_indx < uint_num_messages; uint_msg_indx++)
+    {
+        bool bool_error = !std::equal(ptr_aligned + vec_offsets[uint_msg_indx], ptr_aligned + vec_offsets[uint_msg_indx + 1],
+                                      ptr_expected + vec_offsets[uint_msg_indx]);
+
+        vec_errors[uint_msg_indx] = bool_error;
+        uint_num_errors += bool_error;
+    }
+
+    return uint_num_errors;
+}
@@ -9,20 +9,24 @@
 #include <cstdlib>
 #include <cstdint>
 
+#include "arena.hpp"
+
 /**
  * @brief finds the indices of the elements with maximum value in a vector.
+ *
+ * The vector functions are instantiated for the heap and the scratch (see arena.hpp) vectors.
  */
-std::vector<size_t> max_indices(const std::vector<size_t>&);
+template <typename A> std::vector<size_t, A> max_indices(const std::vector<size_t, A>&);
 
 /**
  * @brief finds the maximum value in a vector.
  */
-size_t max(const std::vector<size_t>&);
+template <typename A> size_t max(const std::vector<size_t, A>&);
 
 /**
  * @brief looks for a specific value in a vector and returns true it exists.
  */
-bool exist(const std::vector<size_t>&, size_t);
+template <typename A> bool exist(const std::vector<size_t, A>&, size_t);
 
 /**
  * @brief returns the index of the first element (in a vector) that is equal to the given value.
@@ -34,9 +38,67 @@ size_t find_index(const std::vector<size_t>&, size_t);
  */
 size_t randint(size_t uint_max);
 
+/**
+ * @brief choose uniformly random distinct clusters (out of 'uint_num_clusters') for the elements of each message.
+ */
+std::vector<std::vector<size_t>> random_clusters(const std::vector<std::vector<size_t>>& vec_message, size_t uint_num_clusters);
+
 /**
  * @brief rearrange sub-messages with respect to their corresponding clusters.
  */
 std::vector<std::vector<size_t>> sort_clusters(const std::vector<std::vector<size_t>>& vec_message, const std::vector<size_t>& vec_clusters);
 
+/**
+ * @class cluster_slots
+ *
+ * @brief the slot of each cluster in an order given by the caller (a cluster-to-slot lookup table).
+ *
+ * A retrieved message is aligned to the order in linear time in its length, instead of
+ * searching every cluster as sort_clusters does, and written into a buffer of the caller.
+ */
+class cluster_slots
+{
+
+  public:
+    //! an empty order of the clusters of a network of 'nc' clusters.
+    explicit cluster_slots(size_t nc) : vec_slots(nc, SIZE_MAX) {}
+
+    /**
+     * @brief sets the order: the cluster 'vec_clusters[i]' goes to the slot i (linear time).
+     *
+     * It throws std::invalid_argument if a cluster is out of range or repeated, leaving the order empty.
+     */
+    void assign(const std::vector<size_t>& vec_clusters);
+
+    //! the number of slots.
+    size_t size() const { return vec_order.size(); }
+
+    //! the slot of a cluster, SIZE_MAX if it has none.
+    size_t slot(size_t cluster) const { return cluster < vec_slots.size() ? vec_slots[cluster] : SIZE_MAX; }
+
+    /**
+     * @brief writes a retrieved message (its elements and their clusters) in the slots.
+     * @param ptr_aligned the elements in the order, zero for the clusters that are not retrieved.
+     * @return false if a retrieved cluster has no slot (or is out of range), in which case every slot is SIZE_MAX (never an element).
+     */
+    bool align(const std::vector<std::vector<size_t>>& vec_message, size_t* ptr_aligned) const;
+
+  private:
+    std::vector<size_t> vec_slots;
+    std::vector<size_t> vec_order;
+};
+
+/**
+ * @brief compares a batch of aligned messages with the expected ones.
+ * @param vec_offsets the first slot of each message and the total number of slots.
+ * @param ptr_aligned the aligned messages (see cluster_slots).
+ * @param ptr_expected the expected messages.
+ * @param vec_errors the flag of each message, true if it differs from the expected one.
+ * @return the number of messages that differ.
+ */
+size_t compare_messages(const std::vector<size_t>& vec_offsets,
+                        const size_t* ptr_aligned,
+                        const size_t* ptr_expected,
+                        std::vector<bool>& vec_errors);
+
 #endif
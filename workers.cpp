@@ -0,0 +1,146 @@
+/**
+ * @file workers.cpp
+ * @brief pool of worker threads
+ */
+
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <algorithm>
+
+#include "workers.hpp"
+
+worker_pool::worker_pool(size_t nthreads) : uint_running(0), stopping(false)
+{
+    if (nthreads == 0) nthreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (size_t uint_indx = 0; uint_indx < nthreads; uint_indx++)
+    {
+        workers.emplace_back(&worker_pool::run, this);
+    }
+}
+
+worker_pool::~worker_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_tasks);
+        stopping = true;
+    }
+
+    cv_tasks.notify_all();
+
+    for (size_t uint_indx = 0; uint_indx < workers.size(); uint_indx++)
+    {
+        workers[uint_indx].join();
+    }
+}
+
+worker_pool& worker_pool::shared()
+{
+    static worker_pool pool;
+    return pool;
+}
+
+void worker_pool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_tasks);
+        tasks.push_back(std::move(task));
+    }
+
+    cv_tasks.notify_one();
+}
+
+void worker_pool::drain()
+{
+    std::unique_lock<std::mutex> lock(mtx_tasks);
+    cv_idle.wait(lock, [this]() { return tasks.empty() && uint_running == 0; });
+}
+
+void worker_pool::run()
+{
+    while (true)
+    {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(mtx_tasks);
+            cv_tasks.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+            if (tasks.empty()) return;
+
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            uint_running++;
+        }
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_tasks);
+            uint_running--;
+            if (tasks.empty() && uint_running == 0) cv_idle.notify_all();
+        }
+    }
+}
+
+// The indices are claimed from a shared counter by the calling thread and by helper
+// tasks, one per worker at most. A helper that starts after all the indices have been
+// claimed returns at once, so the caller only waits for the calls in progress.
+void worker_pool::parallel_for(size_t n, const std::function<void(size_t)>& fn)
+{
+    struct loop_state
+    {
+        std::atomic<size_t>         next;
+        size_t                      done;
+        std::exception_ptr          error;
+        std::mutex                  mtx;
+        std::condition_variable     cv;
+    };
+
+    if (n == 0) return;
+
+    std::shared_ptr<loop_state> state = std::make_shared<loop_state>();
+    state->next = 0;
+    state->done = 0;
+
+    const std::function<void(size_t)>* ptr_fn = &fn;
+
+    std::function<void()> work = [state, ptr_fn, n]() {
+        size_t uint_count = 0;
+
+        for (size_t uint_indx = state->next++; uint_indx < n; uint_indx = state->next++)
+        {
+            try
+            {
+                (*ptr_fn)(uint_indx);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(state->mtx);
+                if (!state->error) state->error = std::current_exception();
+            }
+
+            uint_count++;
+        }
+
+        if (uint_count > 0)
+        {
+            std::lock_guard<std::mutex> lock(state->mtx);
+            state->done += uint_count;
+            if (state->done == n) state->cv.notify_all();
+        }
+    };
+
+    for (size_t uint_indx = 0; uint_indx < std::min(workers.size(), n - 1); uint_indx++)
+    {
+        submit(work);
+    }
+
+    work();
+
+    std::unique_lock<std::mutex> lock(state->mtx);
+    state->cv.wait(lock, [&state, n]() { return state->done == n; });
+
+    if (state->error) std::rethrow_exception(state->error);
+}
@@ -0,0 +1,68 @@
+/**
+ * @file workers.hpp
+ * @brief pool of worker threads
+ *
+ * The workers are started once and run the tasks of a queue, so that the
+ * networks that share a pool do not start threads on every recall.
+ */
+#ifndef __WORKERS_HPP__
+#define __WORKERS_HPP__
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <cstdlib>
+
+class worker_pool
+{
+
+  public:
+    /**
+     * @brief starts the workers.
+     * @param nthreads the number of workers (the number of cores if zero).
+     */
+    explicit worker_pool(size_t nthreads = 0);
+
+    //! destructor (runs the queued tasks and stops the workers)
+    ~worker_pool();
+
+    worker_pool(const worker_pool&) = delete;
+    worker_pool& operator=(const worker_pool&) = delete;
+
+    //! the number of workers.
+    size_t size() const { return workers.size(); }
+
+    //! the workers of the process (one per core), started at the first call.
+    static worker_pool& shared();
+
+    //! queues a task.
+    void submit(std::function<void()> task);
+
+    //! waits until the queue is empty and no task runs (not to be called from a task).
+    void drain();
+
+    /**
+     * @brief calls 'fn(i)' for every i in [0, n) on the workers and waits for all of them.
+     *
+     * The calling thread takes part in the work, so that a task may call parallel_for
+     * without waiting for the workers it occupies. The first exception thrown by 'fn'
+     * is thrown again once all the calls are done.
+     */
+    void parallel_for(size_t n, const std::function<void(size_t)>& fn);
+
+  private:
+    void run();
+
+    std::vector<std::thread>            workers;
+    std::deque<std::function<void()>>   tasks;
+    std::mutex                          mtx_tasks;
+    std::condition_variable             cv_tasks;
+    std::condition_variable             cv_idle;
+    size_t                              uint_running;   // the number of tasks being run
+    bool                                stopping;
+};
+
+#endif